@@ -0,0 +1,569 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "micro_kernel.hpp"
+#include "micro_thread_pool.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Scale test driver: registers thousands of synthetic plugins, drives task,
+// message and stream load through the kernel and reports tick jitter,
+// dispatch latency, kernel CPU overhead and memory per plugin as JSON.
+//
+//   micro-kernel-scale --plugins 10000 --seconds 10 --task-us 20 --fanout 1
+//                      --streams 100 --threads 8 --queue 1024
+//                      --churn-rate 500 --out result.json
+//
+// Built with MICRO_KERNEL_TRACE, --trace FILE also writes a Chrome trace of
+// the run.
+
+typedef int harness_key;
+
+static const int64_t kTickPeriodNs = 10 * 1000 * 1000;
+
+static int64_t now_ns(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double process_cpu_s(void) {
+#if defined(_WIN32)
+    FILETIME create_tm, exit_tm, kernel_tm, user_tm;
+    if (!GetProcessTimes(GetCurrentProcess(), &create_tm, &exit_tm, &kernel_tm, &user_tm)) {
+        return 0;
+    }
+    uint64_t k = (static_cast<uint64_t>(kernel_tm.dwHighDateTime) << 32) | kernel_tm.dwLowDateTime;
+    uint64_t u = (static_cast<uint64_t>(user_tm.dwHighDateTime) << 32) | user_tm.dwLowDateTime;
+    return (k + u) / 1e7;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+        (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+static uint64_t process_rss_bytes(void) {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return 0;
+    }
+    return pmc.WorkingSetSize;
+#else
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    statm >> size >> resident;
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Log-linear histogram of nanosecond samples: 16 linear sub-buckets per
+// power of two, lock-free recording.
+class LatencyHistogram {
+public:
+    LatencyHistogram() { reset(); }
+
+    void record(int64_t ns) {
+        uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        counts_[index(v)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        uint64_t cur = max_.load(std::memory_order_relaxed);
+        while (v > cur && !max_.compare_exchange_weak(cur, v)) {
+        }
+    }
+
+    void reset(void) {
+        for (auto& c : counts_) {
+            c = 0;
+        }
+        count_ = 0;
+        max_ = 0;
+    }
+
+    uint64_t count(void) const { return count_; }
+
+    double percentile_us(double p) const {
+        uint64_t total = count_;
+        if (!total) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(p * total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            seen += counts_[i];
+            if (seen > rank) {
+                return value(i) / 1000.0;
+            }
+        }
+        return max_ / 1000.0;
+    }
+
+    std::string json(void) const {
+        std::ostringstream os;
+        os << "{\"count\": " << count_
+            << ", \"p50\": " << percentile_us(0.50)
+            << ", \"p90\": " << percentile_us(0.90)
+            << ", \"p99\": " << percentile_us(0.99)
+            << ", \"p999\": " << percentile_us(0.999)
+            << ", \"max\": " << max_ / 1000.0 << "}";
+        return os.str();
+    }
+
+private:
+    static const size_t kSub = 16;
+    static const size_t kBuckets = 64 * kSub;
+
+    static size_t index(uint64_t v) {
+        if (v < kSub) {
+            return static_cast<size_t>(v);
+        }
+        int msb = 63;
+        while (!(v >> msb)) {
+            msb--;
+        }
+        int shift = msb - 4;
+        return (shift + 1) * kSub + ((v >> shift) & (kSub - 1));
+    }
+
+    static uint64_t value(size_t idx) {
+        size_t major = idx / kSub;
+        size_t sub = idx % kSub;
+        if (!major) {
+            return sub;
+        }
+        return (kSub + sub) << (major - 1);
+    }
+
+    std::atomic<uint64_t> counts_[kBuckets];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> max_;
+};
+
+struct HarnessConfig {
+    HarnessConfig()
+        : plugins(10000), seconds(5), task_us(0), fanout(1), streams(0),
+        threads(std::thread::hardware_concurrency()), queue(1024), churn_rate(500) {
+    }
+
+    uint32_t plugins;
+    uint32_t seconds;
+    uint32_t task_us;
+    uint32_t fanout;
+    uint32_t streams;
+    uint32_t threads;
+    uint32_t queue;
+    uint32_t churn_rate;
+    std::string out;
+    std::string trace;
+};
+
+struct HarnessStats {
+    LatencyHistogram tick_interval;
+    LatencyHistogram tick_jitter;
+    LatencyHistogram dispatch;
+    LatencyHistogram stream;
+    LatencyHistogram churn;
+    std::atomic<uint64_t> dispatch_failed;
+    std::atomic<uint64_t> work_cpu_ns;
+
+    void reset(void) {
+        tick_interval.reset();
+        tick_jitter.reset();
+        dispatch.reset();
+        stream.reset();
+        churn.reset();
+        dispatch_failed = 0;
+        work_cpu_ns = 0;
+    }
+};
+
+// Stream whose send() queues a timestamp and notifies the kernel, so the
+// sink's stream_event() can measure send-to-handler latency.
+class HarnessStream : public IPluginStream<harness_key> {
+public:
+    HarnessStream(const PluginKey<harness_key>& from, const PluginKey<harness_key>& to)
+        : IPluginStream<harness_key>(from, to), closed_(false) {
+    }
+
+    virtual void close() override {
+        closed_ = true;
+        notify(E_STREAM_CLOSED);
+    }
+    virtual bool is_closed(void) override { return closed_; }
+
+    virtual int send(const PluginDataT& data, const time_t /*wait*/ = -1) override {
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            sent_.push_back(now_ns());
+        }
+        notify(E_STREAM_READABLE);
+        return data.len;
+    }
+
+    virtual int recv(PluginDataT& data, const time_t /*wait*/ = -1) override {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (sent_.empty() || !data.data || data.len < static_cast<int>(sizeof(int64_t))) {
+            return 0;
+        }
+        std::memcpy(data.data, &sent_.front(), sizeof(int64_t));
+        sent_.pop_front();
+        return sizeof(int64_t);
+    }
+
+private:
+    std::mutex mtx_;
+    std::deque<int64_t> sent_;
+    std::atomic_bool closed_;
+};
+
+struct HarnessContext {
+    HarnessConfig cfg;
+    HarnessStats stats;
+    std::vector<std::shared_ptr<HarnessStream>> streams;
+};
+
+static void spin_cpu(uint32_t us) {
+    uint64_t end = micro_thread_cpu_ns() + us * 1000ULL;
+    while (micro_thread_cpu_ns() < end) {
+    }
+}
+
+class SyntheticPlugin : public IPlugin<harness_key> {
+public:
+    SyntheticPlugin(const PluginKey<harness_key>& key, HarnessContext* ctx)
+        : IPlugin<harness_key>(key), ctx_(ctx), last_tick_(0),
+        rng_(static_cast<uint32_t>(key.key) * 2654435761u + 1) {
+    }
+
+    virtual bool plugin_init(void) override { return true; }
+    virtual bool plugin_start(void) override { return true; }
+
+    virtual bool plugin_task(void) override {
+        int64_t start = now_ns();
+        int64_t last = last_tick_.exchange(start);
+        if (last) {
+            int64_t gap = start - last;
+            ctx_->stats.tick_interval.record(gap);
+            ctx_->stats.tick_jitter.record(gap > kTickPeriodNs ? gap - kTickPeriodNs : kTickPeriodNs - gap);
+        }
+
+        if (ctx_->cfg.task_us) {
+            uint64_t cpu = micro_thread_cpu_ns();
+            spin_cpu(ctx_->cfg.task_us);
+            ctx_->stats.work_cpu_ns += micro_thread_cpu_ns() - cpu;
+        }
+
+        char reqb[16] = "ping";
+        char resb[16] = "";
+        for (uint32_t i = 0; i < ctx_->cfg.fanout; i++) {
+            PluginDataT req{ 1, 4, reqb };
+            PluginDataT res{ 0, sizeof(resb), resb };
+            harness_key to = static_cast<harness_key>(next() % ctx_->cfg.plugins);
+
+            int64_t t0 = now_ns();
+            if (get_micro_kernel_service()->message_dispatch(plugin_handle(), to, req, res)) {
+                ctx_->stats.dispatch.record(now_ns() - t0);
+            }
+            else {
+                ctx_->stats.dispatch_failed++;
+            }
+        }
+
+        size_t idx = static_cast<size_t>(plugin_key().key);
+        if (idx < ctx_->streams.size()) {
+            PluginDataT item{ 0, 0, nullptr };
+            ctx_->streams[idx]->send(item);
+        }
+        return true;
+    }
+
+    virtual bool plugin_task_en(void) override { return true; }
+    virtual bool plugin_stop(void) override { return true; }
+    virtual bool plugin_exit(void) override { return true; }
+    virtual bool notice(const PluginDataT& /*msg*/) override { return true; }
+
+    virtual bool message(const PluginMessage<harness_key>& /*request*/,
+        PluginMessage<harness_key>& response) override {
+        if (response.data.data && response.data.len >= 4) {
+            std::memcpy(response.data.data, "pong", 4);
+            response.data.len = 4;
+        }
+        return true;
+    }
+
+    virtual bool stream(std::shared_ptr<IPluginStream<harness_key>> /*stream*/) override {
+        return true;
+    }
+
+private:
+    uint32_t next(void) {
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 17;
+        rng_ ^= rng_ << 5;
+        return rng_;
+    }
+
+    HarnessContext* ctx_;
+    std::atomic<int64_t> last_tick_;
+    uint32_t rng_;
+};
+
+// Reactive sink for every harness stream; never scheduled as a task.
+class StreamSinkPlugin : public IPlugin<harness_key> {
+public:
+    StreamSinkPlugin(const PluginKey<harness_key>& key, HarnessContext* ctx)
+        : IPlugin<harness_key>(key), ctx_(ctx) {
+    }
+
+    virtual bool plugin_init(void) override { return true; }
+    virtual bool plugin_start(void) override { return true; }
+    virtual bool plugin_task(void) override { return true; }
+    virtual bool plugin_task_en(void) override { return false; }
+    virtual bool plugin_stop(void) override { return true; }
+    virtual bool plugin_exit(void) override { return true; }
+    virtual bool notice(const PluginDataT& /*msg*/) override { return true; }
+
+    virtual bool message(const PluginMessage<harness_key>& /*request*/,
+        PluginMessage<harness_key>& /*response*/) override {
+        return true;
+    }
+
+    virtual bool stream(std::shared_ptr<IPluginStream<harness_key>> /*stream*/) override {
+        return true;
+    }
+
+    virtual bool stream_reactive(void) override { return true; }
+
+    virtual bool stream_event(std::shared_ptr<IPluginStream<harness_key>> stream,
+        uint32_t events) override {
+        int64_t sent = 0;
+        PluginDataT item{ 0, sizeof(sent), &sent };
+        while (stream->recv(item, 0) > 0) {
+            ctx_->stats.stream.record(now_ns() - sent);
+            item.len = sizeof(sent);
+        }
+        return !(events & E_STREAM_CLOSED);
+    }
+
+private:
+    HarnessContext* ctx_;
+};
+
+static bool parse_args(int argc, char** argv, HarnessConfig& cfg) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string val = argv[++i];
+        if (arg == "--out") {
+            cfg.out = val;
+            continue;
+        }
+        if (arg == "--trace") {
+            cfg.trace = val;
+            continue;
+        }
+
+        uint32_t n = static_cast<uint32_t>(std::strtoul(val.c_str(), nullptr, 10));
+        if (arg == "--plugins") cfg.plugins = n;
+        else if (arg == "--seconds") cfg.seconds = n;
+        else if (arg == "--task-us") cfg.task_us = n;
+        else if (arg == "--fanout") cfg.fanout = n;
+        else if (arg == "--streams") cfg.streams = n;
+        else if (arg == "--threads") cfg.threads = n;
+        else if (arg == "--queue") cfg.queue = n;
+        else if (arg == "--churn-rate") cfg.churn_rate = n;
+        else {
+            std::cerr << "unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    if (!cfg.plugins || !cfg.seconds || !cfg.threads || !cfg.queue) {
+        std::cerr << "--plugins, --seconds, --threads and --queue must be > 0" << std::endl;
+        return false;
+    }
+    cfg.streams = std::min(cfg.streams, cfg.plugins);
+    return true;
+}
+
+static std::shared_ptr<SyntheticPlugin> make_plugin(harness_key key, HarnessContext* ctx) {
+    PluginKey<harness_key> pk{ "synthetic", "1.0.0", key };
+    return std::make_shared<SyntheticPlugin>(pk, ctx);
+}
+
+// Runs one measurement window; with churn_rate > 0 a second thread keeps
+// unregistering and re-registering random plugins at that rate meanwhile.
+static std::string run_phase(MicroKernel<harness_key>& kernel, HarnessContext& ctx,
+    bool churn) {
+    ctx.stats.reset();
+    std::atomic_bool done(false);
+    std::atomic<uint64_t> churn_ops(0);
+
+    std::thread churner;
+    if (churn && ctx.cfg.churn_rate) {
+        churner = std::thread([&] {
+            uint32_t rng = 0x9e3779b9u;
+            auto interval = std::chrono::nanoseconds(1000000000LL / ctx.cfg.churn_rate);
+            auto next = std::chrono::steady_clock::now();
+            while (!done) {
+                rng ^= rng << 13;
+                rng ^= rng >> 17;
+                rng ^= rng << 5;
+                harness_key key = static_cast<harness_key>(rng % ctx.cfg.plugins);
+
+                int64_t t0 = now_ns();
+                kernel.plugin_unregister(key);
+                kernel.plugin_register(make_plugin(key, &ctx));
+                ctx.stats.churn.record(now_ns() - t0);
+                churn_ops++;
+
+                next += interval;
+                std::this_thread::sleep_until(next);
+            }
+            });
+    }
+
+    double cpu0 = process_cpu_s();
+    int64_t wall0 = now_ns();
+    std::this_thread::sleep_for(std::chrono::seconds(ctx.cfg.seconds));
+    double cpu = process_cpu_s() - cpu0;
+    double wall = (now_ns() - wall0) / 1e9;
+
+    done = true;
+    if (churner.joinable()) {
+        churner.join();
+    }
+
+    double work = ctx.stats.work_cpu_ns / 1e9;
+    double overhead = cpu > work ? cpu - work : 0;
+    uint64_t ticks = ctx.stats.tick_interval.count();
+
+    std::ostringstream os;
+    os << "{\n"
+        << "    \"wall_s\": " << wall << ",\n"
+        << "    \"tick_interval_us\": " << ctx.stats.tick_interval.json() << ",\n"
+        << "    \"tick_jitter_us\": " << ctx.stats.tick_jitter.json() << ",\n"
+        << "    \"task_runs_per_s\": " << ticks / wall << ",\n"
+        << "    \"dispatch_latency_us\": " << ctx.stats.dispatch.json() << ",\n"
+        << "    \"dispatch_per_s\": " << ctx.stats.dispatch.count() / wall << ",\n"
+        << "    \"dispatch_failed\": " << ctx.stats.dispatch_failed << ",\n"
+        << "    \"stream_latency_us\": " << ctx.stats.stream.json() << ",\n"
+        << "    \"cpu\": {\"process_s\": " << cpu
+        << ", \"plugin_work_s\": " << work
+        << ", \"kernel_overhead_s\": " << overhead
+        << ", \"kernel_overhead_ns_per_task\": " << (ticks ? overhead * 1e9 / ticks : 0)
+        << "}";
+    if (churn) {
+        os << ",\n    \"churn\": {\"ops\": " << churn_ops
+            << ", \"ops_per_s\": " << churn_ops / wall
+            << ", \"latency_us\": " << ctx.stats.churn.json() << "}";
+    }
+    os << "\n  }";
+    return os.str();
+}
+
+int main(int argc, char** argv) {
+    HarnessContext ctx;
+    if (!parse_args(argc, argv, ctx.cfg)) {
+        std::cerr << "usage: micro-kernel-scale [--plugins N] [--seconds S] [--task-us US]"
+            " [--fanout M] [--streams N] [--threads N] [--queue N] [--churn-rate OPS]"
+            " [--out FILE] [--trace FILE]" << std::endl;
+        return 1;
+    }
+    const HarnessConfig& cfg = ctx.cfg;
+
+    auto thread_pool = std::make_shared<MicroKernelThreadPool>(cfg.queue, cfg.threads);
+    MicroKernel<harness_key> kernel(cfg.plugins + 1, thread_pool);
+
+    uint64_t rss0 = process_rss_bytes();
+    int64_t reg0 = now_ns();
+    for (uint32_t i = 0; i < cfg.plugins; i++) {
+        kernel.plugin_register(make_plugin(static_cast<harness_key>(i), &ctx));
+    }
+    double reg_s = (now_ns() - reg0) / 1e9;
+    uint64_t rss1 = process_rss_bytes();
+
+    harness_key sink_key = static_cast<harness_key>(cfg.plugins);
+    PluginKey<harness_key> sink_pk{ "stream-sink", "1.0.0", sink_key };
+    kernel.plugin_register(std::make_shared<StreamSinkPlugin>(sink_pk, &ctx));
+    for (uint32_t i = 0; i < cfg.streams; i++) {
+        PluginKey<harness_key> from{ "synthetic", "1.0.0", static_cast<harness_key>(i) };
+        auto stream = std::make_shared<HarnessStream>(from, sink_pk);
+        kernel.stream_dispatch(stream);
+        ctx.streams.push_back(stream);
+    }
+
+    std::thread runner([&kernel] { kernel.run(); });
+    while (!kernel.running()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::string steady = run_phase(kernel, ctx, false);
+    std::string churn = run_phase(kernel, ctx, true);
+
+    kernel.stop();
+    runner.join();
+    for (auto& stream : ctx.streams) {
+        stream->close();
+    }
+
+    std::ostringstream os;
+    os << "{\n"
+        << "  \"config\": {\"plugins\": " << cfg.plugins
+        << ", \"seconds\": " << cfg.seconds
+        << ", \"task_us\": " << cfg.task_us
+        << ", \"fanout\": " << cfg.fanout
+        << ", \"streams\": " << cfg.streams
+        << ", \"threads\": " << cfg.threads
+        << ", \"queue\": " << cfg.queue
+        << ", \"churn_rate\": " << cfg.churn_rate << "},\n"
+        << "  \"register\": {\"seconds\": " << reg_s
+        << ", \"rss_before_bytes\": " << rss0
+        << ", \"rss_after_bytes\": " << rss1
+        << ", \"bytes_per_plugin\": " << (rss1 > rss0 ? (rss1 - rss0) / cfg.plugins : 0) << "},\n"
+        << "  \"steady\": " << steady << ",\n"
+        << "  \"churn\": " << churn << "\n"
+        << "}\n";
+
+    if (cfg.out.empty()) {
+        std::cout << os.str();
+    }
+    else {
+        std::ofstream out(cfg.out);
+        out << os.str();
+    }
+
+    if (!cfg.trace.empty() && !MICRO_TRACE_FLUSH(cfg.trace)) {
+        std::cerr << "could not write " << cfg.trace
+            << " (tracing needs MICRO_KERNEL_TRACE)" << std::endl;
+    }
+    return 0;
+}
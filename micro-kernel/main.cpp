@@ -71,7 +71,6 @@ public:
         }
         domain_type t1 = E_DOMAIN_BASIC;
         domain_type t2 = E_DOMAIN_ALARM;
-        PluginKey<domain_type> from{ "basic", "1.0.0", E_DOMAIN_BASIC };
         PluginKey<domain_type> to;
         to.key = t2;
 
@@ -84,7 +83,7 @@ public:
         res.len = sizeof(resb);
         res.data = resb;
 
-        get_micro_kernel_service()->message_dispatch(from, t2, req, res);
+        get_micro_kernel_service()->message_dispatch(plugin_handle(), t2, req, res);
         {
             std::lock_guard<std::mutex> lock(g_cout_mutex);
             std::cout << "message back : " << (char*)res.data << std::endl;
@@ -200,7 +199,7 @@ public:
         PluginMessage<domain_type>& response) override {
             {
                 std::lock_guard<std::mutex> lock(g_cout_mutex);
-                std::cout << "alarm message, from : " << request.from.name
+                std::cout << "alarm message, from : " << request.from.name()
                     << ", msg : " << (char*)request.data.data << std::endl;
             }
             sprintf_s((char*)response.data.data, response.data.len, "hihi basic");
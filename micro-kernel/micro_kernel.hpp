@@ -3,12 +3,19 @@
 #include <iostream>
 #include <mutex>
 #include <stdexcept>
+#include "micro_message_cache.hpp"
+#include "micro_pipeline.hpp"
+#include "micro_plugin_monitor.hpp"
+#include "micro_reactor.hpp"
 #include "micro_thread_pool.hpp"
+#include "micro_trace.hpp"
 #include "plugin.hpp"
 #include <condition_variable>
 #include <atomic>
+#include <limits>
 #include <list>
 #include <map>
+#include <set>
 #include <string>
 #include <shared_mutex>
 #include <chrono>
@@ -18,39 +25,248 @@
 
 #define MICRO_KERNEL_VERSION "1.0.0"
 
+// Binds a stream to a stream_reactive() plugin: stream notifications signal
+// the reactor, and on_ready() delivers the accumulated events on a pool worker.
+template <typename T>
+class MicroKernelStreamSource
+    : public IReactorSource,
+    public std::enable_shared_from_this<MicroKernelStreamSource<T>> {
+public:
+    MicroKernelStreamSource(std::shared_ptr<MicroReactor> reactor,
+        std::shared_ptr<IPlugin<T>> plugin,
+        std::shared_ptr<IPluginStream<T>> stream)
+        : reactor_(reactor), plugin_(plugin), stream_(stream), detached_(false) {
+    }
+
+    void attach(void) {
+        std::weak_ptr<MicroKernelStreamSource<T>> weak = this->shared_from_this();
+        reactor_->attach(this->shared_from_this());
+        stream_->set_waker([weak] {
+            auto self = weak.lock();
+            if (self) {
+                self->reactor_->signal(self);
+            }
+            });
+        stream_->wake();
+    }
+
+    // Also used by the kernel when the target plugin goes away; a pending
+    // on_ready() then returns without calling stream_event().
+    void detach(void) {
+        if (detached_.exchange(true)) {
+            return;
+        }
+        stream_->set_waker(nullptr);
+        reactor_->detach(this->shared_from_this());
+    }
+
+    virtual void on_ready(void) override {
+        for (;;) {
+            if (detached_) {
+                return;
+            }
+            uint32_t events = stream_->take_events();
+            if (events) {
+                MICRO_TRACE_SCOPE("plugin", "stream_event", plugin_->plugin_handle().id);
+                if (!plugin_->stream_event(stream_, events) || (events & E_STREAM_CLOSED)) {
+                    detach();
+                    return;
+                }
+            }
+            disarm();
+            if (!stream_->has_events() || !try_arm()) {
+                return;
+            }
+        }
+    }
+
+private:
+    std::shared_ptr<MicroReactor> reactor_;
+    std::shared_ptr<IPlugin<T>> plugin_;
+    std::shared_ptr<IPluginStream<T>> stream_;
+    std::atomic_bool detached_;
+};
+
+// Collects fd readiness for one plugin on the reactor thread and hands it to
+// IPlugin::fd_event() on a pool worker. A level-triggered fd is re-armed only
+// after its events were delivered, so a busy fd cannot flood the pool.
+template <typename T>
+class MicroKernelFdSource
+    : public IReactorSource,
+    public IReactorFdWatch,
+    public std::enable_shared_from_this<MicroKernelFdSource<T>> {
+public:
+    MicroKernelFdSource(std::shared_ptr<MicroReactor> reactor,
+        std::shared_ptr<IPlugin<T>> plugin)
+        : reactor_(reactor), plugin_(plugin) {
+    }
+
+    void watch(uint64_t id) {
+        std::lock_guard<std::mutex> lck(mtx_);
+        ids_.insert(id);
+    }
+
+    // Drops id and any of its events not yet delivered.
+    void forget(uint64_t id) {
+        std::lock_guard<std::mutex> lck(mtx_);
+        ids_.erase(id);
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            if (it->id == id) {
+                it = pending_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    virtual void on_fd(uint64_t id, int fd, uint32_t events) override {
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            if (ids_.find(id) == ids_.end()) {
+                return;
+            }
+            bool merged = false;
+            for (auto& item : pending_) {
+                if (item.id == id) {
+                    item.events |= events;
+                    merged = true;
+                    break;
+                }
+            }
+            if (!merged) {
+                pending_.push_back(Pending{ id, fd, events });
+            }
+        }
+        reactor_->signal(this->shared_from_this());
+    }
+
+    virtual void on_ready(void) override {
+        std::vector<Pending> pending;
+        std::vector<PluginFdEvent> events;
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lck(mtx_);
+                pending.swap(pending_);
+                events.clear();
+                for (auto& item : pending) {
+                    if (ids_.find(item.id) != ids_.end()) {
+                        events.push_back(PluginFdEvent{ item.fd, item.events });
+                    }
+                }
+            }
+            if (!events.empty()) {
+                MICRO_TRACE_SCOPE("plugin", "fd_event", plugin_->plugin_handle().id);
+                plugin_->fd_event(events);
+            }
+            if (!pending.empty()) {
+                for (auto& item : pending) {
+                    reactor_->fd_rearm(item.id);
+                }
+                pending.clear();
+            }
+
+            disarm();
+            {
+                std::lock_guard<std::mutex> lck(mtx_);
+                if (pending_.empty()) {
+                    return;
+                }
+            }
+            if (!try_arm()) {
+                return;
+            }
+        }
+    }
+
+private:
+    struct Pending {
+        uint64_t id;
+        int fd;
+        uint32_t events;
+    };
+
+    std::shared_ptr<MicroReactor> reactor_;
+    std::shared_ptr<IPlugin<T>> plugin_;
+    std::mutex mtx_;
+    std::set<uint64_t> ids_;
+    std::vector<Pending> pending_;
+};
+
 template <typename T>
 class MicroKernel : public IMicroKernelServices<T> {
 public:
-    MicroKernel(uint32_t plugin_limit, std::shared_ptr<IThreadPool> thread_pool)
+    MicroKernel(uint32_t plugin_limit, std::shared_ptr<IThreadPool> thread_pool,
+        size_t message_cache_limit = 4096)
         : version_(MICRO_KERNEL_VERSION),
         limit_(plugin_limit),
         thread_pool_(thread_pool),
+        message_cache_(message_cache_limit),
+        reactor_(std::make_shared<MicroReactor>(thread_pool)),
+        monitor_(std::make_shared<MicroPluginMonitor<T>>([](const std::string& message) {
+            std::cout << "[MicroKernel LOG] " << message << std::endl;
+            })),
         running_(false),
-        exit_(false) {
+        exit_(false),
+        stop_requested_(false) {
         if (!thread_pool_) {
             throw std::invalid_argument("thread_pool is null");
         }
     }
 
-    virtual ~MicroKernel() { stop(); }
+    virtual ~MicroKernel() {
+        stop();
+        monitor_->stop();
+        reactor_->stop();
+    }
+
+    // Per-invocation CPU budgets for plugin_task(), message() and stream().
+    // Plugins that overrun policy.quarantine_after times in a row have their
+    // tasks moved to a small quarantine pool until they stay within budget
+    // for policy.release_after runs; invocations running longer than
+    // policy.stall_ms are reported by a watchdog.
+    void budget_policy(const MicroBudgetPolicy& policy) {
+        monitor_->policy(policy);
+    }
+
+    // Overrides policy.budget_us for one plugin; also works without a
+    // budget_policy(), using the default quarantine thresholds.
+    bool plugin_budget(const T& key, uint32_t budget_us) {
+        std::shared_lock<std::shared_mutex> lck(mtx_);
+
+        auto it = plugins_.find(key);
+        if (it == plugins_.end()) {
+            return false;
+        }
+        monitor_->budget(*it->second->plugin_account_, budget_us);
+        return true;
+    }
+
+    bool running(void) const { return running_; }
 
     void run(void) {
+        MICRO_TRACE_THREAD("kernel");
         {
             std::unique_lock<std::shared_mutex> lck(mtx_);
 
             if (running_) {
                 return;
             }
+            if (stop_requested_) {
+                stop_requested_ = false;
+                return;
+            }
 
-            std::list<PluginKey<T>> bad_plugin;
+            std::list<T> bad_plugin;
 
             for (auto& kv : plugins_) {
                 if (kv.second) {
+                    MICRO_TRACE_SCOPE("plugin", "plugin_init", kv.second->plugin_handle().id);
                     kv.second->set_micro_kernel_srv(this);
                     if (!kv.second->plugin_init()) {
                         kv.second->set_plugin_status(E_PLUGIN_BAD);
-                        std::cout << "plugin : [name = " << kv.first.name
-                            << "] [version = " << kv.first.version
+                        std::cout << "plugin : [name = " << kv.second->plugin_key().name
+                            << "] [version = " << kv.second->plugin_key().version
                             << "] init failed" << std::endl;
                         bad_plugin.push_front(kv.first);
                     }
@@ -67,10 +283,11 @@ public:
 
             for (auto& kv : plugins_) {
                 if (kv.second) {
+                    MICRO_TRACE_SCOPE("plugin", "plugin_start", kv.second->plugin_handle().id);
                     if (!kv.second->plugin_start()) {
                         kv.second->set_plugin_status(E_PLUGIN_BAD);
-                        std::cout << "plugin : [name = " << kv.first.name
-                            << "] [version = " << kv.first.version
+                        std::cout << "plugin : [name = " << kv.second->plugin_key().name
+                            << "] [version = " << kv.second->plugin_key().version
                             << "] start failed" << std::endl;
                         bad_plugin.push_front(kv.first);
                     }
@@ -92,20 +309,27 @@ public:
             exit_ = false;
         }
 
+        std::vector<thread_task_t> tasks;
         while (running_) {
             {
-                std::shared_lock<std::shared_mutex> lck(mtx_);
-
-                for (auto& kv : plugins_) {
-                    if (!running_) {
-                        break;
-                    }
-                    if (kv.second->plugin_task_en()) {
-                        thread_pool_->add_task([plug = kv.second] {
-                            plug->plugin_task();
-                            });
+                MICRO_TRACE_SCOPE("kernel", "tick", 0);
+                {
+                    std::shared_lock<std::shared_mutex> lck(mtx_);
+
+                    tasks.reserve(plugins_.size());
+                    for (auto& kv : plugins_) {
+                        if (!running_) {
+                            break;
+                        }
+                        if (kv.second->plugin_task_en()) {
+                            plugin_task_post(kv.second, tasks);
+                        }
                     }
                 }
+                if (running_ && !tasks.empty()) {
+                    thread_pool_->add_tasks(tasks);
+                }
+                tasks.clear();
             }
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
@@ -116,11 +340,13 @@ public:
         }
     }
 
-private:
+    // A stop() that gets here before run() has started makes that run()
+    // return at once instead of looping forever.
     void stop(void) {
         std::unique_lock<std::shared_mutex> lck(mtx_);
 
         if (!running_) {
+            stop_requested_ = true;
             return;
         }
 
@@ -128,6 +354,8 @@ private:
 
         micro_kernel_exited_.wait(lck, [this] { return exit_; });
 
+        stream_release(nullptr);
+        fd_release_all(nullptr);
         for (auto& kv : plugins_) {
             if (E_PLUGIN_RUNING == kv.second->plugin_status()) {
                 kv.second->plugin_stop();
@@ -137,6 +365,47 @@ private:
         }
     }
 
+private:
+    std::shared_ptr<IThreadPool> task_pool(const std::shared_ptr<MicroPluginAccount>& account) {
+        if (!account || !account->quarantined()) {
+            return thread_pool_;
+        }
+        std::call_once(quarantine_flag_, [this] {
+            quarantine_pool_ = std::make_shared<MicroKernelThreadPool>(
+                limit_, monitor_->policy().quarantine_threads);
+            });
+        return quarantine_pool_;
+    }
+
+    // Tasks for the shared pool are collected into `tasks` and submitted once
+    // per tick; quarantined plugins still go to their pool one at a time.
+    void plugin_task_post(const std::shared_ptr<IPlugin<T>>& plugin,
+        std::vector<thread_task_t>& tasks) {
+        auto monitor = monitor_;
+        auto account = plugin->plugin_account_;
+        auto pool = task_pool(account);
+        if (pool == thread_pool_) {
+            tasks.push_back([monitor, account, plugin] {
+                MICRO_TRACE_SCOPE("plugin", "plugin_task", plugin->plugin_handle().id);
+                monitor->invoke(account, plugin->plugin_handle(), [&plugin] {
+                    return plugin->plugin_task();
+                    });
+                });
+            return;
+        }
+
+        if (!account->flight_begin()) {
+            return;
+        }
+        pool->add_task([monitor, account, plugin] {
+            MICRO_TRACE_SCOPE("plugin", "plugin_task", plugin->plugin_handle().id);
+            monitor->invoke(account, plugin->plugin_handle(), [&plugin] {
+                return plugin->plugin_task();
+                });
+            account->flight_end();
+            });
+    }
+
 public:
     virtual std::string micro_kernel_version(void) override {
         return version_;
@@ -147,62 +416,190 @@ public:
         return static_cast<uint32_t>(plugins_.size());
     }
 
-    virtual bool plugin_key(const T& key, PluginKey<T>& item_key) override {
+    virtual bool plugin_usage(const T& key, PluginUsage& usage) override {
         std::shared_lock<std::shared_mutex> lck(mtx_);
 
-        PluginKey<T> tmp;
-        tmp.key = key;
+        auto it = plugins_.find(key);
+        if (it == plugins_.end()) {
+            return false;
+        }
+        it->second->plugin_account_->usage(usage);
+        return true;
+    }
+
+    virtual bool plugin_key(const T& key, PluginKey<T>& item_key) override {
+        std::shared_lock<std::shared_mutex> lck(mtx_);
 
-        auto it = plugins_.find(tmp);
+        auto it = plugins_.find(key);
         if (it == plugins_.end()) {
             return false;
         }
-        item_key = it->first;
+        item_key = it->second->plugin_key();
         return true;
     }
 
-    virtual bool message_dispatch(const PluginKey<T>& from, const T& to_key,
+    virtual bool message_dispatch(const PluginHandle<T>& from, const T& to_key,
         const PluginDataT& request,
         PluginDataT& response) override {
         std::shared_lock<std::shared_mutex> lck(mtx_);
 
-        PluginKey<T> to;
-        to.key = to_key;
-
-        auto it = plugins_.find(to);
+        auto it = plugins_.find(to_key);
         if (it == plugins_.end()) {
             return false;
         }
 
-        to = it->first;
         auto plugin = it->second;
+        const PluginHandle<T> to = plugin->plugin_handle();
+        // Taken under the lock so plugin_unregister's invalidation is ordered
+        // against it.
+        const uint64_t epoch = message_cache_.epoch(to_key);
 
         lck.unlock();
 
+        MICRO_TRACE_SCOPE("dispatch", "message_dispatch", to.id);
+        time_t ttl = plugin->message_cache_ttl(request.type);
+        if (ttl > 0 && message_cache_.lookup(to_key, request, response)) {
+            return true;
+        }
+
         const PluginMessage<T> req_msg{ from, to, request };
         PluginMessage<T> res_msg{ to, from, response };
 
-        bool ret = plugin->message(req_msg, res_msg);
+        bool ret = monitor_->invoke(plugin->plugin_account_, to, [&] {
+            return plugin->message(req_msg, res_msg);
+            });
         response = res_msg.data;
+        if (ret && ttl > 0) {
+            message_cache_.store(to_key, request, response, ttl, epoch);
+        }
         return ret;
     }
 
     virtual bool stream_dispatch(std::shared_ptr<IPluginStream<T>> stream) override {
+        MICRO_TRACE_SCOPE("dispatch", "stream_dispatch", 0);
         std::shared_lock<std::shared_mutex> lck(mtx_);
 
-        auto it = plugins_.find(stream->to_);
+        auto it = plugins_.find(stream->to_.key);
         if (it == plugins_.end()) {
             return false;
         }
-        stream->to_.name = it->first.name;
-        stream->to_.version = it->first.version;
         auto plugin = it->second;
-        thread_pool_->add_task([=] {
-            plugin->stream(stream);
+        stream->to_ = plugin->plugin_handle();
+
+        if (plugin->stream_reactive()) {
+            auto source = std::make_shared<MicroKernelStreamSource<T>>(reactor_, plugin, stream);
+            source->attach();
+
+            std::lock_guard<std::mutex> stream_lck(stream_mtx_);
+            auto range = streams_.equal_range(it->first);
+            for (auto s_it = range.first; s_it != range.second;) {
+                if (s_it->second.expired()) {
+                    s_it = streams_.erase(s_it);
+                }
+                else {
+                    ++s_it;
+                }
+            }
+            streams_.insert(std::make_pair(it->first, std::weak_ptr<MicroKernelStreamSource<T>>(source)));
+            return true;
+        }
+        lck.unlock();
+
+        auto monitor = monitor_;
+        auto account = plugin->plugin_account_;
+        task_pool(account)->add_task([monitor, account, plugin, stream] {
+            MICRO_TRACE_SCOPE("plugin", "stream", plugin->plugin_handle().id);
+            monitor->invoke(account, plugin->plugin_handle(), [&] {
+                return plugin->stream(stream);
+                });
             });
         return true;
     }
 
+    virtual void message_cache_invalidate(const T& key) override {
+        message_cache_.invalidate(key);
+    }
+
+    virtual void message_cache_invalidate(const T& key, int type) override {
+        message_cache_.invalidate(key, type);
+    }
+
+    virtual MessageCacheStats message_cache_stats(void) override {
+        return message_cache_.stats();
+    }
+
+    virtual bool fd_register(const T& key, int fd, uint32_t events,
+        uint32_t flags = E_FD_LEVEL) override {
+        // Held until the fd is added so plugin_unregister() cannot release
+        // the plugin's fds in between and miss this one.
+        std::shared_lock<std::shared_mutex> lck(mtx_);
+
+        auto it = plugins_.find(key);
+        if (it == plugins_.end()) {
+            return false;
+        }
+        auto plugin = it->second;
+
+        std::lock_guard<std::mutex> fd_lck(fd_mtx_);
+        if (fds_.find(std::make_pair(key, fd)) != fds_.end()) {
+            return false;
+        }
+
+        FdRegistration reg;
+        if (flags & E_FD_BATCH) {
+            auto batch_it = fd_batch_.find(key);
+            if (batch_it == fd_batch_.end()) {
+                batch_it = fd_batch_.insert(std::make_pair(key,
+                    std::make_shared<MicroKernelFdSource<T>>(reactor_, plugin))).first;
+            }
+            reg.source = batch_it->second;
+        }
+        else {
+            reg.source = std::make_shared<MicroKernelFdSource<T>>(reactor_, plugin);
+        }
+        reg.edge = (flags & E_FD_EDGE) != 0;
+        reg.batch = (flags & E_FD_BATCH) != 0;
+        reg.id = reactor_->fd_reserve();
+        reg.source->watch(reg.id);
+        if (!reactor_->fd_add(reg.id, fd, events, reg.edge, reg.source)) {
+            reg.source->forget(reg.id);
+            if (reg.batch && fd_batch_users(key) == 0) {
+                fd_batch_.erase(key);
+            }
+            return false;
+        }
+        fds_.insert(std::make_pair(std::make_pair(key, fd), reg));
+        return true;
+    }
+
+    virtual bool fd_modify(const T& key, int fd, uint32_t events) override {
+        std::lock_guard<std::mutex> lck(fd_mtx_);
+        auto it = fds_.find(std::make_pair(key, fd));
+        if (it == fds_.end()) {
+            return false;
+        }
+        return reactor_->fd_modify(it->second.id, events, it->second.edge);
+    }
+
+    virtual bool fd_unregister(const T& key, int fd) override {
+        std::lock_guard<std::mutex> lck(fd_mtx_);
+        auto it = fds_.find(std::make_pair(key, fd));
+        if (it == fds_.end()) {
+            return false;
+        }
+        fd_release(it);
+        return true;
+    }
+
+    virtual std::shared_ptr<IPluginPipeline<T>> pipeline_create(void) override {
+        return std::make_shared<MicroPipeline<T>>([this](const T& key) {
+            std::shared_lock<std::shared_mutex> lck(mtx_);
+
+            auto it = plugins_.find(key);
+            return it == plugins_.end() ? std::shared_ptr<IPlugin<T>>() : it->second;
+            }, thread_pool_);
+    }
+
     virtual void log(const std::string& message) override {
         std::cout << "[MicroKernel LOG] " << message << std::endl;
     }
@@ -213,13 +610,17 @@ public:
             return false;
         }
 
-        auto item = plugins_.find(plugin->plugin_key_);
+        auto item = plugins_.find(plugin->plugin_key_.key);
         if (item != plugins_.end()) {
             return false;
         }
 
         plugin->set_micro_kernel_srv(this);
+        if (!plugin->plugin_account_) {
+            plugin->plugin_account_ = std::make_shared<MicroPluginAccount>();
+        }
         if (running_) {
+            MICRO_TRACE_SCOPE("plugin", "plugin_init_start", plugin->plugin_handle().id);
             if (!plugin->plugin_init() || !plugin->plugin_start()) {
                 plugin->set_micro_kernel_srv(nullptr);
                 return false;
@@ -227,20 +628,18 @@ public:
             plugin->set_plugin_status(E_PLUGIN_RUNING);
         }
 
-        plugins_.insert(std::make_pair(plugin->plugin_key_, plugin));
+        plugins_.insert(std::make_pair(plugin->plugin_key_.key, plugin));
         return true;
     }
 
     bool plugin_unregister(const T& key) {
         std::unique_lock<std::shared_mutex> lck(mtx_);
 
-        PluginKey<T> tmp;
-        tmp.key = key;
-
-        auto it = plugins_.find(tmp);
+        auto it = plugins_.find(key);
         if (it == plugins_.end()) {
             return false;
         }
+        stream_release(&key);
         if (running_ && it->second->plugin_status() == E_PLUGIN_RUNING) {
             it->second->plugin_stop();
             it->second->plugin_exit();
@@ -248,18 +647,95 @@ public:
         }
 
         plugins_.erase(it);
+        message_cache_.invalidate(key);
+
+        fd_release_all(&key);
         return true;
     }
 
+private:
+    struct FdRegistration {
+        uint64_t id;
+        bool edge;
+        bool batch;
+        std::shared_ptr<MicroKernelFdSource<T>> source;
+    };
+
+    typedef std::map<std::pair<T, int>, FdRegistration> fd_map_t;
+
+    // Detaches the reactive streams bound to key, or to every plugin when
+    // key is null.
+    void stream_release(const T* key) {
+        std::list<std::shared_ptr<MicroKernelStreamSource<T>>> sources;
+        {
+            std::lock_guard<std::mutex> lck(stream_mtx_);
+            auto first = key ? streams_.lower_bound(*key) : streams_.begin();
+            auto last = key ? streams_.upper_bound(*key) : streams_.end();
+            for (auto it = first; it != last; ++it) {
+                auto source = it->second.lock();
+                if (source) {
+                    sources.push_back(source);
+                }
+            }
+            streams_.erase(first, last);
+        }
+        for (auto& source : sources) {
+            source->detach();
+        }
+    }
+
+    // Releases the fds registered by key, or by every plugin when key is null.
+    void fd_release_all(const T* key) {
+        std::lock_guard<std::mutex> lck(fd_mtx_);
+        auto it = key ? fds_.lower_bound(std::make_pair(*key, std::numeric_limits<int>::min()))
+            : fds_.begin();
+        while (it != fds_.end() && (!key || !(*key < it->first.first))) {
+            fd_release(it++);
+        }
+    }
+
+    size_t fd_batch_users(const T& key) {
+        size_t cnt = 0;
+        auto it = fds_.lower_bound(std::make_pair(key, std::numeric_limits<int>::min()));
+        for (; it != fds_.end() && !(key < it->first.first); ++it) {
+            if (it->second.batch) {
+                cnt++;
+            }
+        }
+        return cnt;
+    }
+
+    void fd_release(typename fd_map_t::iterator it) {
+        T key = it->first.first;
+        bool batch = it->second.batch;
+        reactor_->fd_del(it->second.id);
+        it->second.source->forget(it->second.id);
+        fds_.erase(it);
+        if (batch && fd_batch_users(key) == 0) {
+            fd_batch_.erase(key);
+        }
+    }
+
 private:
     std::shared_mutex mtx_;
     std::string version_;
     uint32_t limit_;
-    std::map<PluginKey<T>, std::shared_ptr<IPlugin<T>>> plugins_;
+    std::map<T, std::shared_ptr<IPlugin<T>>> plugins_;
     std::shared_ptr<IThreadPool> thread_pool_;
+    MicroMessageCache<T> message_cache_;
+    std::shared_ptr<MicroReactor> reactor_;
+    std::shared_ptr<MicroPluginMonitor<T>> monitor_;
+    std::shared_ptr<IThreadPool> quarantine_pool_;
+    std::once_flag quarantine_flag_;
+    std::mutex stream_mtx_;
+    std::multimap<T, std::weak_ptr<MicroKernelStreamSource<T>>> streams_;
+    std::mutex fd_mtx_;
+    fd_map_t fds_;
+    std::map<T, std::shared_ptr<MicroKernelFdSource<T>>> fd_batch_;
     std::condition_variable_any micro_kernel_exited_;  
     std::atomic_bool running_;
     bool exit_;
+    bool stop_requested_;
 
 };
 
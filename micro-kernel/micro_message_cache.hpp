@@ -0,0 +1,240 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include "plugin.hpp"
+
+
+// std::hash<T> when the key has one. Keys with only operator< still work;
+// they hash to 0 and just share shards and invalidation epochs.
+template <typename T, typename = void>
+struct MicroKeyHash {
+    size_t operator()(const T& /*key*/) const { return 0; }
+};
+
+template <typename T>
+struct MicroKeyHash<T, typename std::enable_if<std::is_default_constructible<std::hash<T>>::value>::type> {
+    size_t operator()(const T& key) const { return std::hash<T>()(key); }
+};
+
+// Bounded response cache for message_dispatch. Entries are keyed by
+// (target key, message type, request payload) and expire after the ttl the
+// target plugin reported through IPlugin::message_cache_ttl(). Invalidation
+// bumps a per-key epoch, and store() drops responses computed under an older
+// epoch, so a dispatch that was in flight during an invalidation cannot put
+// its stale result back.
+template <typename T>
+class MicroMessageCache {
+public:
+    MicroMessageCache(size_t limit, size_t shard_cnt = 16)
+        : shards_(shard_cnt ? shard_cnt : 1), hits_(0), misses_(0) {
+        shard_limit_ = limit / shards_.size();
+        if (shard_limit_ == 0) {
+            shard_limit_ = 1;
+        }
+        for (auto& epoch : epochs_) {
+            epoch = 0;
+        }
+    }
+
+    // Read before calling the plugin and pass to store(). Keys share epoch
+    // slots by hash, so a collision only costs an extra miss.
+    uint64_t epoch(const T& key) const {
+        return epochs_[epoch_slot(key)].load();
+    }
+
+    bool lookup(const T& key, const PluginDataT& request, PluginDataT& response) {
+        CacheKey ck{ key, request.type, payload_hash(request) };
+        Shard& shard = shard_of(ck);
+        {
+            std::lock_guard<std::mutex> lck(shard.mtx);
+
+            auto it = shard.index.find(ck);
+            if (it != shard.index.end()) {
+                auto entry = it->second;
+                if (entry->expire < clock::now()) {
+                    shard.lru.erase(entry);
+                    shard.index.erase(it);
+                }
+                else if (same_request(*entry, request) &&
+                    response.data && response.len >= static_cast<int>(entry->response.size())) {
+                    if (!entry->response.empty()) {
+                        std::memcpy(response.data, entry->response.data(), entry->response.size());
+                    }
+                    response.type = entry->response_type;
+                    response.len = static_cast<int>(entry->response.size());
+                    shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+                    hits_.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void store(const T& key, const PluginDataT& request, const PluginDataT& response,
+        time_t ttl_ms, uint64_t epoch) {
+        if (ttl_ms <= 0 || response.len < 0 || (response.len > 0 && !response.data)) {
+            return;
+        }
+
+        CacheKey ck{ key, request.type, payload_hash(request) };
+        Shard& shard = shard_of(ck);
+        std::lock_guard<std::mutex> lck(shard.mtx);
+        if (epoch != epochs_[epoch_slot(key)].load()) {
+            return;
+        }
+
+        auto it = shard.index.find(ck);
+        if (it != shard.index.end()) {
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+        while (shard.lru.size() >= shard_limit_) {
+            shard.index.erase(shard.lru.back().key);
+            shard.lru.pop_back();
+        }
+
+        Entry entry;
+        entry.key = ck;
+        entry.expire = clock::now() + std::chrono::milliseconds(ttl_ms);
+        if (request.len > 0 && request.data) {
+            auto p = static_cast<const uint8_t*>(request.data);
+            entry.request.assign(p, p + request.len);
+        }
+        entry.response_type = response.type;
+        if (response.len > 0) {
+            auto p = static_cast<const uint8_t*>(response.data);
+            entry.response.assign(p, p + response.len);
+        }
+        shard.lru.push_front(std::move(entry));
+        shard.index[ck] = shard.lru.begin();
+    }
+
+    void invalidate(const T& key) {
+        epochs_[epoch_slot(key)]++;
+        invalidate_if([&key](const CacheKey& ck) { return same_key(ck.key, key); });
+    }
+
+    void invalidate(const T& key, int type) {
+        epochs_[epoch_slot(key)]++;
+        invalidate_if([&key, type](const CacheKey& ck) {
+            return ck.type == type && same_key(ck.key, key);
+            });
+    }
+
+    MessageCacheStats stats(void) {
+        MessageCacheStats st;
+        st.hits = hits_.load(std::memory_order_relaxed);
+        st.misses = misses_.load(std::memory_order_relaxed);
+        st.entries = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lck(shard.mtx);
+            st.entries += shard.lru.size();
+        }
+        return st;
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct CacheKey {
+        T key;
+        int type;
+        uint64_t hash;
+
+        // Only operator< is required of T, as for the plugin map.
+        bool operator<(const CacheKey& other) const {
+            if (hash != other.hash) {
+                return hash < other.hash;
+            }
+            if (type != other.type) {
+                return type < other.type;
+            }
+            return key < other.key;
+        }
+    };
+
+    struct Entry {
+        CacheKey key;
+        clock::time_point expire;
+        std::vector<uint8_t> request;
+        int response_type;
+        std::vector<uint8_t> response;
+    };
+
+    struct Shard {
+        std::mutex mtx;
+        std::list<Entry> lru;
+        std::map<CacheKey, typename std::list<Entry>::iterator> index;
+    };
+
+    static uint64_t payload_hash(const PluginDataT& data) {
+        uint64_t h = 1469598103934665603ULL;
+        if (data.len > 0 && data.data) {
+            auto p = static_cast<const uint8_t*>(data.data);
+            for (int i = 0; i < data.len; i++) {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+        }
+        return h;
+    }
+
+    static bool same_request(const Entry& entry, const PluginDataT& request) {
+        size_t len = request.len > 0 && request.data ? static_cast<size_t>(request.len) : 0;
+        if (entry.request.size() != len) {
+            return false;
+        }
+        return len == 0 || std::memcmp(entry.request.data(), request.data, len) == 0;
+    }
+
+    static bool same_key(const T& a, const T& b) {
+        return !(a < b) && !(b < a);
+    }
+
+    static size_t epoch_slot(const T& key) {
+        return MicroKeyHash<T>()(key) % kEpochSlots;
+    }
+
+    Shard& shard_of(const CacheKey& ck) {
+        size_t h = MicroKeyHash<T>()(ck.key);
+        h ^= static_cast<size_t>(ck.type) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= static_cast<size_t>(ck.hash) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return shards_[h % shards_.size()];
+    }
+
+    template <typename Pred>
+    void invalidate_if(Pred pred) {
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lck(shard.mtx);
+            for (auto it = shard.lru.begin(); it != shard.lru.end();) {
+                if (pred(it->key)) {
+                    shard.index.erase(it->key);
+                    it = shard.lru.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+private:
+    static const size_t kEpochSlots = 256;
+
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> epochs_[kEpochSlots];
+    size_t shard_limit_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
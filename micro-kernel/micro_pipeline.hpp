@@ -0,0 +1,341 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "plugin.hpp"
+#include "thread_pool.hpp"
+
+
+// Graph of plugin stages joined by bounded queues. A stage runs as a pool
+// task that drains up to batch_size items per IPlugin::pipeline_batch() call
+// and fans its output out to every connected stage. Output never takes a
+// downstream queue past its limit: what does not fit waits in the producing
+// stage's spill, and the stage takes no new input until the spill has been
+// moved on, so a slow stage stalls its producers all the way back to push(). Stateless plugins get up to
+// `parallel` batches in flight (the pipeline default when 0), which gives up
+// per-stage ordering. Stages made runnable from inside a stage are handed to
+// the pool only if it has room and are otherwise run by the same worker, so
+// a full pool queue never blocks a worker. Batches for a plugin that is not
+// running, or has been unregistered, are dropped.
+template <typename T>
+class MicroPipeline
+    : public IPluginPipeline<T>,
+    public std::enable_shared_from_this<MicroPipeline<T>> {
+public:
+    typedef std::function<std::shared_ptr<IPlugin<T>>(const T&)> plugin_resolver_t;
+
+    MicroPipeline(plugin_resolver_t resolver, std::shared_ptr<IThreadPool> thread_pool,
+        uint32_t parallel = std::thread::hardware_concurrency())
+        : resolver_(resolver),
+        thread_pool_(thread_pool),
+        parallel_(parallel ? parallel : 1),
+        running_(false),
+        stopped_(false),
+        tasks_(0) {
+    }
+
+    virtual ~MicroPipeline() { stop(); }
+
+    virtual int add_stage(const T& key, size_t queue_limit = 1024,
+        size_t batch_size = 32, uint32_t parallel = 0) override {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (running_ || stopped_ || !queue_limit || !batch_size) {
+            return -1;
+        }
+
+        auto plugin = resolver_(key);
+        if (!plugin) {
+            return -1;
+        }
+
+        std::shared_ptr<Stage> stage(new Stage);
+        stage->plugin = plugin;
+        stage->queue_limit = queue_limit;
+        stage->batch_size = batch_size;
+        stage->max_active = 1;
+        if (plugin->plugin_stateless()) {
+            stage->max_active = parallel ? parallel : parallel_;
+        }
+        stages_.push_back(stage);
+        return static_cast<int>(stages_.size() - 1);
+    }
+
+    virtual bool connect(int from_stage, int to_stage) override {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (running_ || stopped_ || !valid(from_stage) || !valid(to_stage) ||
+            reachable(to_stage, from_stage)) {
+            return false;
+        }
+
+        stages_[from_stage]->next.push_back(stages_[to_stage].get());
+        stages_[from_stage]->spill.resize(stages_[from_stage]->next.size());
+        stages_[to_stage]->prev.push_back(stages_[from_stage].get());
+        return true;
+    }
+
+    virtual bool start(void) override {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (stopped_ || stages_.empty()) {
+            return false;
+        }
+        running_ = true;
+        resolver_ = nullptr;
+        return true;
+    }
+
+    virtual bool push(int stage_id, const PluginDataT& item, const time_t wait = -1) override {
+        if (!running_ || !valid(stage_id)) {
+            return false;
+        }
+
+        Stage* stage = stages_[stage_id].get();
+        {
+            std::unique_lock<std::mutex> lck(stage->mtx);
+            auto room = [this, stage] {
+                return stopped_ || stage->queue.size() < stage->queue_limit;
+            };
+            if (wait < 0) {
+                stage->not_full.wait(lck, room);
+            }
+            else if (!stage->not_full.wait_for(lck, std::chrono::milliseconds(wait), room)) {
+                return false;
+            }
+            if (stopped_) {
+                return false;
+            }
+            stage->queue.push_back(item);
+            stage->size++;
+        }
+        schedule(stage);
+        return true;
+    }
+
+    // Waits only for stage tasks that have started; tasks still queued in
+    // the pool return without running once they see stopped_.
+    virtual void stop(void) override {
+        std::unique_lock<std::mutex> lck(mtx_);
+        if (stopped_) {
+            return;
+        }
+        stopped_ = true;
+        running_ = false;
+        for (auto& stage : stages_) {
+            std::lock_guard<std::mutex> stage_lck(stage->mtx);
+            stage->not_full.notify_all();
+        }
+        idle_.wait(lck, [this] { return tasks_ == 0; });
+    }
+
+private:
+    struct Stage {
+        Stage() : queue_limit(0), batch_size(0), max_active(1), active(0), spilled(0), size(0) {}
+
+        std::weak_ptr<IPlugin<T>> plugin;
+        size_t queue_limit;
+        size_t batch_size;
+        uint32_t max_active;
+        std::vector<Stage*> next;
+        std::vector<Stage*> prev;
+
+        std::mutex mtx;
+        std::condition_variable not_full;
+        std::deque<PluginDataT> queue;
+        uint32_t active;
+        std::vector<std::deque<PluginDataT>> spill;    // per next[] entry
+        size_t spilled;
+        std::atomic<size_t> size;
+    };
+
+    bool valid(int stage_id) const {
+        return stage_id >= 0 && static_cast<size_t>(stage_id) < stages_.size();
+    }
+
+    bool reachable(int from, int to) const {
+        if (from == to) {
+            return true;
+        }
+        std::vector<const Stage*> todo{ stages_[from].get() };
+        std::vector<const Stage*> seen;
+        while (!todo.empty()) {
+            const Stage* cur = todo.back();
+            todo.pop_back();
+            if (cur == stages_[to].get()) {
+                return true;
+            }
+            bool visited = false;
+            for (auto s : seen) {
+                visited = visited || s == cur;
+            }
+            if (visited) {
+                continue;
+            }
+            seen.push_back(cur);
+            for (auto s : cur->next) {
+                todo.push_back(s);
+            }
+        }
+        return false;
+    }
+
+    static bool downstream_full(const Stage* stage) {
+        for (auto s : stage->next) {
+            if (s->size.load() >= s->queue_limit) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Moves spilled output into the downstream queues as far as their limits
+    // allow. Called with stage->mtx held; stages only lock downstream while
+    // holding their own lock, and the graph is acyclic.
+    static bool flush(Stage* stage) {
+        bool moved = false;
+        for (size_t i = 0; i < stage->next.size(); i++) {
+            auto& spill = stage->spill[i];
+            if (spill.empty()) {
+                continue;
+            }
+            Stage* s = stage->next[i];
+            std::lock_guard<std::mutex> lck(s->mtx);
+            while (!spill.empty() && s->queue.size() < s->queue_limit) {
+                s->queue.push_back(spill.front());
+                spill.pop_front();
+                s->size++;
+                stage->spilled--;
+                moved = true;
+            }
+        }
+        return moved;
+    }
+
+    // local is the calling worker's run list; null when called from push().
+    void schedule(Stage* stage, std::vector<Stage*>* local = nullptr) {
+        bool fed = false;
+        bool post = false;
+        {
+            std::lock_guard<std::mutex> lck(stage->mtx);
+            if (!stopped_ && stage->spilled) {
+                fed = flush(stage);
+            }
+            if (!stopped_ && !stage->spilled && !stage->queue.empty() &&
+                stage->active < stage->max_active && !downstream_full(stage)) {
+                stage->active++;
+                post = true;
+            }
+        }
+        if (fed) {
+            for (auto s : stage->next) {
+                schedule(s, local);
+            }
+        }
+        if (!post) {
+            return;
+        }
+
+        auto self = this->shared_from_this();
+        thread_task_t task = [self, stage] { self->run(stage); };
+        if (!local) {
+            thread_pool_->add_task(task);
+        }
+        else if (!thread_pool_->try_add_task(task)) {
+            local->push_back(stage);
+        }
+    }
+
+    void run(Stage* stage) {
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            if (stopped_) {
+                return;
+            }
+            tasks_++;
+        }
+        std::vector<Stage*> local{ stage };
+        while (!local.empty()) {
+            Stage* cur = local.back();
+            local.pop_back();
+            drain(cur, local);
+        }
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (--tasks_ == 0) {
+            idle_.notify_all();
+        }
+    }
+
+    void drain(Stage* stage, std::vector<Stage*>& local) {
+        std::vector<PluginDataT> in;
+        std::vector<PluginDataT> out;
+        for (;;) {
+            in.clear();
+            out.clear();
+            bool fed = false;
+            bool done = false;
+            {
+                std::lock_guard<std::mutex> lck(stage->mtx);
+                if (!stopped_ && stage->spilled) {
+                    fed = flush(stage);
+                }
+                if (stopped_ || stage->spilled || stage->queue.empty() || downstream_full(stage)) {
+                    stage->active--;
+                    done = true;
+                }
+                else {
+                    while (!stage->queue.empty() && in.size() < stage->batch_size) {
+                        in.push_back(stage->queue.front());
+                        stage->queue.pop_front();
+                    }
+                    stage->size -= in.size();
+                    stage->not_full.notify_all();
+                }
+            }
+
+            if (fed) {
+                for (auto s : stage->next) {
+                    schedule(s, &local);
+                }
+            }
+            if (done) {
+                return;
+            }
+            for (auto s : stage->prev) {
+                schedule(s, &local);
+            }
+
+            auto plugin = stage->plugin.lock();
+            if (!plugin || plugin->plugin_status() != E_PLUGIN_RUNING ||
+                !plugin->pipeline_batch(in, out) || out.empty()) {
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lck(stage->mtx);
+                for (auto& spill : stage->spill) {
+                    spill.insert(spill.end(), out.begin(), out.end());
+                    stage->spilled += out.size();
+                }
+                flush(stage);
+            }
+            for (auto s : stage->next) {
+                schedule(s, &local);
+            }
+        }
+    }
+
+private:
+    plugin_resolver_t resolver_;
+    std::shared_ptr<IThreadPool> thread_pool_;
+    uint32_t parallel_;
+    std::mutex mtx_;
+    std::vector<std::shared_ptr<Stage>> stages_;
+    std::atomic_bool running_;
+    std::atomic_bool stopped_;
+    std::condition_variable idle_;
+    uint32_t tasks_;
+};
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "plugin.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+
+inline uint64_t micro_thread_cpu_ns(void) {
+#if defined(_WIN32)
+    FILETIME create_tm, exit_tm, kernel_tm, user_tm;
+    if (!GetThreadTimes(GetCurrentThread(), &create_tm, &exit_tm, &kernel_tm, &user_tm)) {
+        return 0;
+    }
+    uint64_t k = (static_cast<uint64_t>(kernel_tm.dwHighDateTime) << 32) | kernel_tm.dwLowDateTime;
+    uint64_t u = (static_cast<uint64_t>(user_tm.dwHighDateTime) << 32) | user_tm.dwLowDateTime;
+    return (k + u) * 100;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+#else
+    return static_cast<uint64_t>(std::clock()) * (1000000000ULL / CLOCKS_PER_SEC);
+#endif
+}
+
+struct MicroBudgetPolicy {
+    MicroBudgetPolicy(uint32_t budget_us = 0, uint32_t quarantine_after = 3,
+        uint32_t release_after = 20, uint32_t stall_ms = 500,
+        uint32_t quarantine_threads = 2)
+        : budget_us(budget_us),
+        quarantine_after(quarantine_after),
+        release_after(release_after),
+        stall_ms(stall_ms),
+        quarantine_threads(quarantine_threads) {
+    }
+
+    uint32_t budget_us;           // per-invocation CPU budget, 0 = no budget
+    uint32_t quarantine_after;    // consecutive overruns before quarantine
+    uint32_t release_after;       // consecutive in-budget runs before release
+    uint32_t stall_ms;            // watchdog wall-time threshold, 0 = off
+    uint32_t quarantine_threads;
+};
+
+// CPU usage and quarantine state of one plugin. Counters are updated from
+// whichever thread ran the invocation, so strike counting is approximate
+// when a plugin's message() runs concurrently.
+class MicroPluginAccount {
+public:
+    MicroPluginAccount()
+        : budget_us_(0), calls_(0), cpu_ns_(0), overruns_(0),
+        strikes_(0), clean_(0), quarantined_(false), in_flight_(false) {
+    }
+
+    void budget(uint32_t budget_us) { budget_us_ = budget_us; }
+    uint32_t budget(void) const { return budget_us_; }
+    bool quarantined(void) const { return quarantined_; }
+
+    // At most one quarantined plugin_task() is queued at a time, so the
+    // bounded quarantine pool never blocks the scheduler tick.
+    bool flight_begin(void) { return !in_flight_.exchange(true); }
+    void flight_end(void) { in_flight_ = false; }
+
+    // Returns +1 when the plugin enters quarantine, -1 when it leaves it.
+    int record(uint64_t cpu_ns, const MicroBudgetPolicy& policy) {
+        calls_.fetch_add(1, std::memory_order_relaxed);
+        cpu_ns_.fetch_add(cpu_ns, std::memory_order_relaxed);
+
+        uint32_t budget_us = budget_us_.load();
+        uint64_t budget_ns = static_cast<uint64_t>(budget_us ? budget_us : policy.budget_us) * 1000;
+        if (!budget_ns) {
+            return 0;
+        }
+        if (cpu_ns > budget_ns) {
+            overruns_.fetch_add(1, std::memory_order_relaxed);
+            clean_ = 0;
+            if (++strikes_ >= policy.quarantine_after && !quarantined_.exchange(true)) {
+                return 1;
+            }
+        }
+        else {
+            strikes_ = 0;
+            if (++clean_ >= policy.release_after && quarantined_.exchange(false)) {
+                clean_ = 0;
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    void usage(PluginUsage& usage) const {
+        usage.calls = calls_.load(std::memory_order_relaxed);
+        usage.cpu_us = cpu_ns_.load(std::memory_order_relaxed) / 1000;
+        usage.overruns = overruns_.load(std::memory_order_relaxed);
+        usage.quarantined = quarantined_;
+    }
+
+private:
+    std::atomic<uint32_t> budget_us_;
+    std::atomic<uint64_t> calls_;
+    std::atomic<uint64_t> cpu_ns_;
+    std::atomic<uint64_t> overruns_;
+    std::atomic<uint32_t> strikes_;
+    std::atomic<uint32_t> clean_;
+    std::atomic_bool quarantined_;
+    std::atomic_bool in_flight_;
+};
+
+// Measures plugin invocations against the budget policy and runs the stall
+// watchdog. Measuring is skipped entirely until a policy or a per-plugin
+// budget is configured.
+template <typename T>
+class MicroPluginMonitor {
+public:
+    typedef std::function<void(const std::string&)> monitor_log_t;
+
+    MicroPluginMonitor(monitor_log_t log)
+        : id_(next_id()),
+        log_(log),
+        enabled_(false),
+        budgeted_(false),
+        budget_us_(0),
+        quarantine_after_(policy_.quarantine_after),
+        release_after_(policy_.release_after),
+        running_(false),
+        stop_(false) {
+    }
+
+    virtual ~MicroPluginMonitor() { stop(); }
+
+    // A quarantine pool needs at least one thread or quarantined plugins
+    // never run again, and a tiny stall_ms would make the watchdog spin.
+    void policy(const MicroBudgetPolicy& policy) {
+        std::lock_guard<std::mutex> lck(mtx_);
+        policy_ = policy;
+        if (!policy_.quarantine_threads) {
+            policy_.quarantine_threads = 1;
+        }
+        if (policy_.stall_ms && policy_.stall_ms < kMinStallMs) {
+            policy_.stall_ms = kMinStallMs;
+        }
+        budget_us_ = policy.budget_us;
+        quarantine_after_ = policy.quarantine_after;
+        release_after_ = policy.release_after;
+        enabled_ = policy_.budget_us > 0 || policy_.stall_ms > 0;
+        watchdog_cv_.notify_all();
+        if (policy_.stall_ms && !running_ && !stop_) {
+            running_ = true;
+            watchdog_ = std::thread([this] { watchdog(); });
+        }
+    }
+
+    MicroBudgetPolicy policy(void) {
+        std::lock_guard<std::mutex> lck(mtx_);
+        return policy_;
+    }
+
+    bool enabled(void) const { return enabled_ || budgeted_; }
+
+    // A per-plugin budget turns measuring on without a kernel-wide policy.
+    void budget(MicroPluginAccount& account, uint32_t budget_us) {
+        account.budget(budget_us);
+        if (budget_us) {
+            budgeted_ = true;
+        }
+    }
+
+    template <typename F>
+    bool invoke(const std::shared_ptr<MicroPluginAccount>& account,
+        const PluginHandle<T>& handle, F fn) {
+        if (!account || !enabled()) {
+            return fn();
+        }
+
+        Slot& slot = slot_of();
+        Invocation prev;
+        {
+            std::lock_guard<std::mutex> lck(slot.mtx);
+            prev = slot.cur;
+            slot.cur = Invocation();
+            slot.cur.active = true;
+            slot.cur.handle = handle;
+            slot.cur.started = std::chrono::steady_clock::now();
+        }
+
+        uint64_t cpu_start = micro_thread_cpu_ns();
+        bool ret = fn();
+        uint64_t cpu_end = micro_thread_cpu_ns();
+
+        // Charge only our own time: nested invocations (a plugin_task() that
+        // dispatches a message) are billed to their target, not the caller.
+        uint64_t cpu_ns = cpu_end > cpu_start ? cpu_end - cpu_start : 0;
+        uint64_t nested_ns;
+        {
+            std::lock_guard<std::mutex> lck(slot.mtx);
+            nested_ns = slot.cur.nested_ns;
+            slot.cur = prev;
+            if (slot.cur.active) {
+                slot.cur.nested_ns += cpu_ns;
+            }
+        }
+
+        MicroBudgetPolicy policy(budget_us_, quarantine_after_, release_after_);
+        int transition = account->record(cpu_ns > nested_ns ? cpu_ns - nested_ns : 0, policy);
+        if (transition > 0) {
+            log_(describe(handle) + " exceeded its budget, moved to quarantine pool");
+        }
+        else if (transition < 0) {
+            log_(describe(handle) + " back within budget, released from quarantine");
+        }
+        return ret;
+    }
+
+    void stop(void) {
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            stop_ = true;
+            watchdog_cv_.notify_all();
+        }
+        if (watchdog_.joinable()) {
+            watchdog_.join();
+        }
+    }
+
+    static std::string describe(const PluginHandle<T>& handle) {
+        std::ostringstream os;
+        os << "plugin : [name = " << handle.name() << "] [version = " << handle.version()
+            << "] [key = ";
+        write_key(os, handle.key, key_kind<T>());
+        os << "]";
+        return os.str();
+    }
+
+private:
+    static const uint32_t kMinStallMs = 10;
+
+    // Keys are printed with operator<< when they have one, enums without one
+    // by value, and anything else as "?".
+    template <typename K, typename = void>
+    struct streamable : std::false_type {};
+
+    template <typename K>
+    struct streamable<K, decltype(void(std::declval<std::ostream&>() << std::declval<const K&>()))>
+        : std::true_type {};
+
+    template <typename K>
+    using key_kind = std::integral_constant<int,
+        streamable<K>::value ? 2 : std::is_enum<K>::value ? 1 : 0>;
+
+    template <typename K>
+    static void write_key(std::ostream& os, const K& key, std::integral_constant<int, 2>) {
+        os << key;
+    }
+
+    template <typename K>
+    static void write_key(std::ostream& os, const K& key, std::integral_constant<int, 1>) {
+        os << static_cast<int64_t>(key);
+    }
+
+    template <typename K>
+    static void write_key(std::ostream& os, const K& /*key*/, std::integral_constant<int, 0>) {
+        os << "?";
+    }
+
+    struct Invocation {
+        Invocation() : active(false), reported(false), nested_ns(0) {}
+
+        bool active;
+        bool reported;
+        uint64_t nested_ns;
+        PluginHandle<T> handle;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    struct Slot {
+        std::mutex mtx;
+        Invocation cur;
+    };
+
+    static uint64_t next_id(void) {
+        static std::atomic<uint64_t> id(0);
+        return ++id;
+    }
+
+    // One slot per (thread, monitor); the watchdog scans them for invocations
+    // running longer than stall_ms.
+    Slot& slot_of(void) {
+        thread_local std::vector<std::pair<uint64_t, std::shared_ptr<Slot>>> slots;
+        for (auto& item : slots) {
+            if (item.first == id_) {
+                return *item.second;
+            }
+        }
+
+        auto slot = std::make_shared<Slot>();
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            slots_.push_back(slot);
+        }
+        slots.push_back(std::make_pair(id_, slot));
+        return *slot;
+    }
+
+    void watchdog(void) {
+        std::unique_lock<std::mutex> lck(mtx_);
+        while (!stop_) {
+            if (!policy_.stall_ms) {
+                watchdog_cv_.wait(lck);
+                continue;
+            }
+            auto stall = std::chrono::milliseconds(policy_.stall_ms);
+            watchdog_cv_.wait_for(lck, stall / 2);
+
+            std::vector<Invocation> stalled;
+            auto now = std::chrono::steady_clock::now();
+            for (auto it = slots_.begin(); it != slots_.end();) {
+                auto slot = it->lock();
+                if (!slot) {
+                    it = slots_.erase(it);
+                    continue;
+                }
+                {
+                    std::lock_guard<std::mutex> slot_lck(slot->mtx);
+                    if (slot->cur.active && !slot->cur.reported && now - slot->cur.started > stall) {
+                        slot->cur.reported = true;
+                        stalled.push_back(slot->cur);
+                    }
+                }
+                ++it;
+            }
+
+            lck.unlock();
+            for (auto& inv : stalled) {
+                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - inv.started);
+                log_(describe(inv.handle) + " stalled for " + std::to_string(ms.count()) + " ms");
+            }
+            lck.lock();
+        }
+    }
+
+private:
+    uint64_t id_;
+    monitor_log_t log_;
+    std::mutex mtx_;
+    MicroBudgetPolicy policy_;
+    std::atomic_bool enabled_;
+    std::atomic_bool budgeted_;
+    std::atomic<uint32_t> budget_us_;
+    std::atomic<uint32_t> quarantine_after_;
+    std::atomic<uint32_t> release_after_;
+    bool running_;
+    bool stop_;
+    std::list<std::weak_ptr<Slot>> slots_;
+    std::condition_variable watchdog_cv_;
+    std::thread watchdog_;
+};
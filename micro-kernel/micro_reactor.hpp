@@ -0,0 +1,349 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "micro_trace.hpp"
+#include "plugin.hpp"
+#include "thread_pool.hpp"
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+
+// Something the reactor can schedule on the thread pool. armed_ is set while
+// the source sits in the ready list or runs, so repeated wakeups coalesce
+// into a single pool task.
+class IReactorSource {
+public:
+    IReactorSource() : armed_(false) {}
+    virtual ~IReactorSource() {}
+
+    virtual void on_ready(void) = 0;
+
+protected:
+    // on_ready() drops the flag once it has drained its work and calls
+    // try_arm() if more work showed up meanwhile; false means a concurrent
+    // signal() already took over the rerun.
+    void disarm(void) { armed_ = false; }
+    bool try_arm(void) { return !armed_.exchange(true); }
+
+private:
+    friend class MicroReactor;
+    std::atomic_bool armed_;
+};
+
+// Receives fd readiness on the reactor thread. Implementations should only
+// record the events and signal() a source; the real work belongs on the pool.
+class IReactorFdWatch {
+public:
+    virtual ~IReactorFdWatch() {}
+
+    virtual void on_fd(uint64_t id, int fd, uint32_t events) = 0;
+};
+
+// Single wakeup thread shared by all readiness-driven sources. Notifiers only
+// touch the ready list and an eventfd (a condition variable off Linux); the
+// reactor thread is the only one that feeds the thread pool, so a full task
+// queue never blocks whoever signalled. On Linux the same epoll set also
+// carries the fds plugins register through fd_add().
+class MicroReactor {
+public:
+    MicroReactor(std::shared_ptr<IThreadPool> thread_pool)
+        : thread_pool_(thread_pool), running_(false), fd_id_(0) {
+#if defined(__linux__)
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd_ >= 0 && event_fd_ >= 0) {
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.u64 = 0;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev);
+        }
+#endif
+        running_ = true;
+        thread_ = std::thread([this] { run(); });
+    }
+
+    virtual ~MicroReactor() {
+        stop();
+#if defined(__linux__)
+        if (event_fd_ >= 0) {
+            close(event_fd_);
+        }
+        if (epoll_fd_ >= 0) {
+            close(epoll_fd_);
+        }
+#endif
+    }
+
+    void stop(void) {
+        std::call_once(flag_, [this] { _stop(); });
+    }
+
+    void attach(std::shared_ptr<IReactorSource> source) {
+        std::lock_guard<std::mutex> lck(mtx_);
+        sources_.insert(source);
+    }
+
+    void detach(std::shared_ptr<IReactorSource> source) {
+        std::lock_guard<std::mutex> lck(mtx_);
+        sources_.erase(source);
+    }
+
+    bool signal(std::shared_ptr<IReactorSource> source) {
+        if (!source->try_arm()) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            if (!running_) {
+                source->disarm();
+                return false;
+            }
+            ready_.push_back(source);
+        }
+        wakeup();
+        return true;
+    }
+
+    // Ids are handed out before fd_add() so a watch can know about an id
+    // before its first on_fd().
+    uint64_t fd_reserve(void) {
+        std::lock_guard<std::mutex> lck(mtx_);
+        return ++fd_id_;
+    }
+
+    // Registers fd under a reserved id with the reactor's epoll set for
+    // fd_event_type interest. Level-triggered fds are one-shot until
+    // fd_rearm(); edge-triggered fds stay armed. Returns false if fds are
+    // unsupported or epoll_ctl fails.
+    bool fd_add(uint64_t id, int fd, uint32_t events, bool edge,
+        std::shared_ptr<IReactorFdWatch> watch) {
+#if defined(__linux__)
+        if (epoll_fd_ < 0 || fd < 0 || !id || !watch) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lck(mtx_);
+        FdEntry entry{ fd, to_epoll(events, edge), watch };
+
+        struct epoll_event ev = {};
+        ev.events = entry.events;
+        ev.data.u64 = id;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            return false;
+        }
+        fds_.insert(std::make_pair(id, entry));
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool fd_modify(uint64_t id, uint32_t events, bool edge) {
+#if defined(__linux__)
+        std::lock_guard<std::mutex> lck(mtx_);
+        auto it = fds_.find(id);
+        if (it == fds_.end()) {
+            return false;
+        }
+        it->second.events = to_epoll(events, edge);
+
+        struct epoll_event ev = {};
+        ev.events = it->second.events;
+        ev.data.u64 = id;
+        return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, it->second.fd, &ev) == 0;
+#else
+        return false;
+#endif
+    }
+
+    bool fd_rearm(uint64_t id) {
+#if defined(__linux__)
+        std::lock_guard<std::mutex> lck(mtx_);
+        auto it = fds_.find(id);
+        if (it == fds_.end() || !(it->second.events & EPOLLONESHOT)) {
+            return false;
+        }
+
+        struct epoll_event ev = {};
+        ev.events = it->second.events;
+        ev.data.u64 = id;
+        return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, it->second.fd, &ev) == 0;
+#else
+        return false;
+#endif
+    }
+
+    void fd_del(uint64_t id) {
+#if defined(__linux__)
+        std::lock_guard<std::mutex> lck(mtx_);
+        auto it = fds_.find(id);
+        if (it == fds_.end()) {
+            return;
+        }
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        fds_.erase(it);
+#endif
+    }
+
+private:
+#if defined(__linux__)
+    struct FdEntry {
+        int fd;
+        uint32_t events;
+        std::shared_ptr<IReactorFdWatch> watch;
+    };
+
+    static uint32_t to_epoll(uint32_t events, bool edge) {
+        uint32_t ev = edge ? EPOLLET : EPOLLONESHOT;
+        if (events & E_FD_READ) {
+            ev |= EPOLLIN | EPOLLRDHUP;
+        }
+        if (events & E_FD_WRITE) {
+            ev |= EPOLLOUT;
+        }
+        return ev;
+    }
+
+    static uint32_t from_epoll(uint32_t ev) {
+        uint32_t events = 0;
+        if (ev & (EPOLLIN | EPOLLPRI)) {
+            events |= E_FD_READ;
+        }
+        if (ev & EPOLLOUT) {
+            events |= E_FD_WRITE;
+        }
+        if (ev & EPOLLERR) {
+            events |= E_FD_ERROR;
+        }
+        if (ev & (EPOLLHUP | EPOLLRDHUP)) {
+            events |= E_FD_HANGUP;
+        }
+        return events;
+    }
+#endif
+
+    void wakeup(void) {
+#if defined(__linux__)
+        if (event_fd_ >= 0) {
+            uint64_t one = 1;
+            ssize_t n = write(event_fd_, &one, sizeof(one));
+            (void)n;
+            return;
+        }
+#endif
+        ready_cv_.notify_one();
+    }
+
+    void run(void) {
+        MICRO_TRACE_THREAD("reactor");
+        std::vector<thread_task_t> tasks;
+        while (running_) {
+            wait();
+
+            MICRO_TRACE_SCOPE("reactor", "schedule", 0);
+            std::list<std::shared_ptr<IReactorSource>> ready;
+            {
+                std::lock_guard<std::mutex> lck(mtx_);
+                ready.swap(ready_);
+            }
+            if (!running_) {
+                break;
+            }
+            tasks.clear();
+            for (auto& source : ready) {
+                tasks.push_back([source] { source->on_ready(); });
+            }
+            if (!tasks.empty()) {
+                thread_pool_->add_tasks(tasks);
+            }
+        }
+    }
+
+    void wait(void) {
+#if defined(__linux__)
+        if (epoll_fd_ >= 0 && event_fd_ >= 0) {
+            struct epoll_event events[64];
+            int n = epoll_wait(epoll_fd_, events, 64, -1);
+            for (int i = 0; i < n; i++) {
+                uint64_t id = events[i].data.u64;
+                if (!id) {
+                    uint64_t cnt;
+                    ssize_t r = read(event_fd_, &cnt, sizeof(cnt));
+                    (void)r;
+                    continue;
+                }
+
+                std::shared_ptr<IReactorFdWatch> watch;
+                int fd = -1;
+                {
+                    std::lock_guard<std::mutex> lck(mtx_);
+                    auto it = fds_.find(id);
+                    if (it != fds_.end()) {
+                        watch = it->second.watch;
+                        fd = it->second.fd;
+                    }
+                }
+                if (watch) {
+                    watch->on_fd(id, fd, from_epoll(events[i].events));
+                }
+            }
+            return;
+        }
+#endif
+        std::unique_lock<std::mutex> lck(mtx_);
+        ready_cv_.wait(lck, [this] { return !running_ || !ready_.empty(); });
+    }
+
+    void _stop(void) {
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            running_ = false;
+        }
+        wakeup();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+
+        std::set<std::shared_ptr<IReactorSource>> sources;
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            ready_.clear();
+            sources.swap(sources_);
+#if defined(__linux__)
+            for (auto& kv : fds_) {
+                epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, kv.second.fd, nullptr);
+            }
+            fds_.clear();
+#endif
+        }
+    }
+
+private:
+    std::shared_ptr<IThreadPool> thread_pool_;
+    std::thread thread_;
+    std::mutex mtx_;
+    std::condition_variable ready_cv_;
+    std::list<std::shared_ptr<IReactorSource>> ready_;
+    std::set<std::shared_ptr<IReactorSource>> sources_;
+    std::atomic_bool running_;
+    std::once_flag flag_;
+    uint64_t fd_id_;
+#if defined(__linux__)
+    std::map<uint64_t, FdEntry> fds_;
+    int epoll_fd_;
+    int event_fd_;
+#endif
+};
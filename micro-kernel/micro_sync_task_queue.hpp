@@ -6,12 +6,13 @@
 #include <condition_variable>
 #include "sync_queue.hpp"
 #include <utility>
+#include <vector>
 
 
 template <typename T>
 class MicroSyncTaskQueue : public ISyncQueue<T> {
 public:
-    MicroSyncTaskQueue(size_t size) : max_size_(size), stop_(false) {}
+    MicroSyncTaskQueue(size_t size) : max_size_(size), waiting_(0), stop_(false) {}
     virtual ~MicroSyncTaskQueue() { stop(); }
 
     virtual bool push(T&& obj) override {
@@ -23,19 +24,55 @@ public:
         }
 
         queue_.push_back(std::forward<T>(obj));
-        not_empty_.notify_one();
+        wake(1);
+        return true;
+    }
+
+    // Like push(), but fails instead of waiting when the queue is full.
+    virtual bool try_push(T&& obj) override {
+        std::unique_lock<std::mutex> lck(mutex_);
+        if (stop_ || count() >= max_size_) {
+            return false;
+        }
+
+        queue_.push_back(std::forward<T>(obj));
+        wake(1);
+        return true;
+    }
+
+    // Enqueues objs in as few lock acquisitions as the size limit allows and
+    // wakes at most one waiting consumer per item added.
+    virtual bool push_batch(std::vector<T>& objs) override {
+        size_t i = 0;
+        std::unique_lock<std::mutex> lck(mutex_);
+        while (i < objs.size()) {
+            not_full_.wait(lck, [this] { return stop_ || (count() < max_size_); });
+
+            if (stop_) {
+                return false;
+            }
+
+            size_t added = 0;
+            for (; i < objs.size() && count() < max_size_; i++, added++) {
+                queue_.push_back(std::move(objs[i]));
+            }
+            wake(added);
+        }
         return true;
     }
 
     virtual bool pop(T& t) override {
         std::unique_lock<std::mutex> lck(mutex_);
-        not_empty_.wait(lck, [this] { return stop_ || !queue_.empty(); });
+        while (!stop_ && queue_.empty()) {
+            waiting_++;
+            not_empty_.wait(lck);
+        }
 
         if (stop_) {
             return false;
         }
 
-        t = queue_.front();
+        t = std::move(queue_.front());
         queue_.pop_front();
         not_full_.notify_one();
         return true;
@@ -49,17 +86,36 @@ public:
         {
             std::unique_lock<std::mutex> lck(mutex_);
             stop_ = true;
+            waiting_ = 0;
         }
         not_full_.notify_all();
         not_empty_.notify_all();
     }
 
 private:
+    // Wakes up to n consumers. waiting_ only counts consumers that have not
+    // been notified yet, so it is decremented here rather than by the woken
+    // thread; a spurious wakeup just re-counts its thread.
+    void wake(size_t n) {
+        if (n >= waiting_) {
+            if (waiting_) {
+                not_empty_.notify_all();
+            }
+            waiting_ = 0;
+            return;
+        }
+        waiting_ -= n;
+        for (size_t i = 0; i < n; i++) {
+            not_empty_.notify_one();
+        }
+    }
+
     std::list<T> queue_;
     std::mutex mutex_;
     std::condition_variable not_empty_;
     std::condition_variable not_full_;
     size_t max_size_;
+    size_t waiting_;
     bool stop_;
 };
 
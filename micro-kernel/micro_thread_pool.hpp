@@ -6,8 +6,10 @@
 #include <list>
 #include <mutex>
 #include <thread>
+#include <vector>
 #include <condition_variable>
 #include "micro_sync_task_queue.hpp"
+#include "micro_trace.hpp"
 #include "thread_pool.hpp"
 
 
@@ -26,6 +28,7 @@ public:
     virtual ~MicroKernelThreadPool() { stop(); }
 
     virtual void run() override {
+        MICRO_TRACE_THREAD("pool worker");
         while (running_) {
             thread_task_t t = nullptr;
             bool ret = queue_.pop(t);
@@ -41,10 +44,45 @@ public:
     }
 
     virtual void add_task(const thread_task_t& task) override {
+#if defined(MICRO_KERNEL_TRACE)
+        MicroTraceScope scope("pool", "enqueue");
+        queue_.push(traced(task));
+#else
         queue_.push([task]() { task(); });
+#endif
+    }
+
+    virtual bool try_add_task(const thread_task_t& task) override {
+#if defined(MICRO_KERNEL_TRACE)
+        MicroTraceScope scope("pool", "enqueue");
+        return queue_.try_push(traced(task));
+#else
+        return queue_.try_push([task]() { task(); });
+#endif
+    }
+
+    virtual void add_tasks(std::vector<thread_task_t>& tasks) override {
+#if defined(MICRO_KERNEL_TRACE)
+        MicroTraceScope scope("pool", "enqueue_batch");
+        for (auto& task : tasks) {
+            task = traced(std::move(task));
+        }
+#endif
+        queue_.push_batch(tasks);
     }
 
 private:
+#if defined(MICRO_KERNEL_TRACE)
+    static thread_task_t traced(thread_task_t task) {
+        uint64_t id = MicroTrace::instance().flow_begin("pool", "task");
+        return [task, id]() {
+            MicroTraceScope scope("pool", "task", 0, id);
+            MicroTrace::instance().flow_end("pool", "task", id);
+            task();
+        };
+    }
+#endif
+
     void _stop(void) {
         queue_.stop();
         running_ = false;
@@ -0,0 +1,259 @@
+#pragma once
+
+// Task lifecycle tracing in Chrome trace-event format (chrome://tracing,
+// ui.perfetto.dev). Compiled in only when MICRO_KERNEL_TRACE is defined;
+// otherwise the MICRO_TRACE_* macros expand to nothing and their arguments
+// are never evaluated.
+
+#if defined(MICRO_KERNEL_TRACE)
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "plugin.hpp"
+
+#ifndef MICRO_KERNEL_TRACE_CHUNKS
+#define MICRO_KERNEL_TRACE_CHUNKS 256
+#endif
+
+struct MicroTraceEvent {
+    const char* cat;
+    const char* name;
+    char ph;
+    uint32_t plugin;    // interned PluginIdentity id, 0 = none
+    uint64_t id;        // flow / task id, 0 = none
+    uint64_t ts;        // ns since trace start
+    uint64_t dur;
+};
+
+// Events of one thread. Only the owning thread appends; size_ is published
+// with release order so flush() can read a consistent prefix without locks.
+// Storage grows in fixed chunks and events are dropped once it is full.
+class MicroTraceBuffer {
+public:
+    static const size_t kChunk = 4096;
+    static const size_t kMaxChunks = MICRO_KERNEL_TRACE_CHUNKS;
+
+    MicroTraceBuffer(uint32_t tid) : tid_(tid), name_(nullptr), size_(0), dropped_(0) {
+        for (auto& chunk : chunks_) {
+            chunk = nullptr;
+        }
+    }
+
+    ~MicroTraceBuffer() {
+        for (auto& chunk : chunks_) {
+            delete[] chunk.load();
+        }
+    }
+
+    void append(const MicroTraceEvent& ev) {
+        size_t n = size_.load(std::memory_order_relaxed);
+        size_t idx = n / kChunk;
+        if (idx >= kMaxChunks) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        MicroTraceEvent* chunk = chunks_[idx].load(std::memory_order_relaxed);
+        if (!chunk) {
+            chunk = new MicroTraceEvent[kChunk];
+            chunks_[idx].store(chunk, std::memory_order_relaxed);
+        }
+        chunk[n % kChunk] = ev;
+        size_.store(n + 1, std::memory_order_release);
+    }
+
+    size_t size(void) const { return size_.load(std::memory_order_acquire); }
+    const MicroTraceEvent& at(size_t i) const {
+        return chunks_[i / kChunk].load(std::memory_order_relaxed)[i % kChunk];
+    }
+
+    uint32_t tid(void) const { return tid_; }
+    uint64_t dropped(void) const { return dropped_.load(std::memory_order_relaxed); }
+    const char* name(void) const { return name_.load(); }
+    void name(const char* name) { name_ = name; }
+
+private:
+    uint32_t tid_;
+    std::atomic<const char*> name_;
+    std::atomic<MicroTraceEvent*> chunks_[kMaxChunks];
+    std::atomic<size_t> size_;
+    std::atomic<uint64_t> dropped_;
+};
+
+class MicroTrace {
+public:
+    static MicroTrace& instance(void) {
+        static MicroTrace trace;
+        return trace;
+    }
+
+    uint64_t now(void) const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch_).count());
+    }
+
+    void complete(const char* cat, const char* name, uint64_t start,
+        uint32_t plugin = 0, uint64_t id = 0) {
+        uint64_t end = now();
+        buffer().append(MicroTraceEvent{ cat, name, 'X', plugin, id, start, end - start });
+    }
+
+    // Flow arrows link the enqueue slice of a task to the slice running it.
+    uint64_t flow_begin(const char* cat, const char* name) {
+        uint64_t id = ++flow_id_;
+        buffer().append(MicroTraceEvent{ cat, name, 's', 0, id, now(), 0 });
+        return id;
+    }
+
+    void flow_end(const char* cat, const char* name, uint64_t id) {
+        buffer().append(MicroTraceEvent{ cat, name, 'f', 0, id, now(), 0 });
+    }
+
+    void thread_name(const char* name) { buffer().name(name); }
+
+    // Writes every event recorded so far; safe while other threads trace.
+    bool flush(const std::string& path) {
+        std::vector<std::shared_ptr<MicroTraceBuffer>> buffers;
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            buffers = buffers_;
+        }
+
+        std::ofstream out(path, std::ios::out | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+
+        uint64_t dropped = 0;
+        bool first = true;
+        char line[128];
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        for (auto& buf : buffers) {
+            dropped += buf->dropped();
+            if (buf->name()) {
+                out << (first ? "" : ",\n")
+                    << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buf->tid()
+                    << ",\"args\":{\"name\":\"" << escape(buf->name()) << "\"}}";
+                first = false;
+            }
+
+            size_t n = buf->size();
+            for (size_t i = 0; i < n; i++) {
+                const MicroTraceEvent& ev = buf->at(i);
+                out << (first ? "" : ",\n")
+                    << "{\"ph\":\"" << ev.ph << "\",\"cat\":\"" << ev.cat
+                    << "\",\"name\":\"" << ev.name << "\",\"pid\":1,\"tid\":" << buf->tid();
+                std::snprintf(line, sizeof(line), ",\"ts\":%llu.%03u",
+                    static_cast<unsigned long long>(ev.ts / 1000),
+                    static_cast<unsigned>(ev.ts % 1000));
+                out << line;
+                if (ev.ph == 'X') {
+                    std::snprintf(line, sizeof(line), ",\"dur\":%llu.%03u",
+                        static_cast<unsigned long long>(ev.dur / 1000),
+                        static_cast<unsigned>(ev.dur % 1000));
+                    out << line;
+                }
+                else if (ev.ph == 's' || ev.ph == 'f') {
+                    out << ",\"id\":" << ev.id << (ev.ph == 'f' ? ",\"bp\":\"e\"" : "");
+                }
+                if (ev.ph == 'X' && (ev.plugin || ev.id)) {
+                    out << ",\"args\":{";
+                    if (ev.plugin) {
+                        out << "\"plugin\":\"" << escape(PluginIdentity::name(ev.plugin).c_str())
+                            << "\"" << (ev.id ? "," : "");
+                    }
+                    if (ev.id) {
+                        out << "\"task\":" << ev.id;
+                    }
+                    out << "}";
+                }
+                out << "}";
+                first = false;
+            }
+        }
+        out << "\n],\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+        return static_cast<bool>(out);
+    }
+
+private:
+    MicroTrace() : epoch_(std::chrono::steady_clock::now()), flow_id_(0), tid_(0) {}
+
+    MicroTraceBuffer& buffer(void) {
+        thread_local std::shared_ptr<MicroTraceBuffer> buf;
+        if (!buf) {
+            std::lock_guard<std::mutex> lck(mtx_);
+            buf = std::make_shared<MicroTraceBuffer>(++tid_);
+            buffers_.push_back(buf);
+        }
+        return *buf;
+    }
+
+    static std::string escape(const char* s) {
+        std::string ret;
+        for (; *s; s++) {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\') {
+                ret += '\\';
+                ret += *s;
+            }
+            else if (c < 0x20) {
+                char hex[8];
+                std::snprintf(hex, sizeof(hex), "\\u%04x", c);
+                ret += hex;
+            }
+            else {
+                ret += *s;
+            }
+        }
+        return ret;
+    }
+
+private:
+    std::chrono::steady_clock::time_point epoch_;
+    std::atomic<uint64_t> flow_id_;
+    std::mutex mtx_;
+    uint32_t tid_;
+    std::vector<std::shared_ptr<MicroTraceBuffer>> buffers_;
+};
+
+class MicroTraceScope {
+public:
+    MicroTraceScope(const char* cat, const char* name, uint32_t plugin = 0, uint64_t id = 0)
+        : cat_(cat), name_(name), plugin_(plugin), id_(id), start_(MicroTrace::instance().now()) {
+    }
+
+    ~MicroTraceScope() {
+        MicroTrace::instance().complete(cat_, name_, start_, plugin_, id_);
+    }
+
+    MicroTraceScope(const MicroTraceScope&) = delete;
+    MicroTraceScope& operator=(const MicroTraceScope&) = delete;
+
+private:
+    const char* cat_;
+    const char* name_;
+    uint32_t plugin_;
+    uint64_t id_;
+    uint64_t start_;
+};
+
+#define MICRO_TRACE_CONCAT_(a, b) a##b
+#define MICRO_TRACE_CONCAT(a, b) MICRO_TRACE_CONCAT_(a, b)
+#define MICRO_TRACE_SCOPE(cat, name, plugin) \
+    MicroTraceScope MICRO_TRACE_CONCAT(micro_trace_scope_, __LINE__)(cat, name, plugin)
+#define MICRO_TRACE_THREAD(name) MicroTrace::instance().thread_name(name)
+#define MICRO_TRACE_FLUSH(path) MicroTrace::instance().flush(path)
+
+#else
+
+#define MICRO_TRACE_SCOPE(cat, name, plugin) ((void)0)
+#define MICRO_TRACE_THREAD(name) ((void)0)
+#define MICRO_TRACE_FLUSH(path) false
+
+#endif
@@ -1,17 +1,24 @@
 #pragma once
 
 #include <time.h>
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 
 template <typename T>
 class IPlugin;
 template <typename T>
 class MicroKernel;
+class MicroPluginAccount;
 
 template <typename T>
 struct PluginKey {
@@ -22,6 +29,7 @@ struct PluginKey {
     PluginKey(const PluginKey<T>& key)
         : name(key.name), version(key.version), key(key.key) {
     }
+    PluginKey<T>& operator=(const PluginKey<T>& key) = default;
 
     bool operator==(const PluginKey<T>& keyn) const { return key == keyn.key; }
     bool operator>(const PluginKey<T>& keyn) const { return key > keyn.key; }
@@ -32,24 +40,138 @@ struct PluginKey {
     T key;
 };
 
+// Process-wide table of plugin (name, version) pairs. Entries are never
+// removed, so an id handed out once stays resolvable; id 0 is the empty pair.
+class PluginIdentity {
+public:
+    static uint32_t intern(const std::string& name, const std::string& version) {
+        Table& tb = table();
+        auto item = std::make_pair(name, version);
+        {
+            std::shared_lock<std::shared_mutex> lck(tb.mtx);
+            auto it = tb.ids.find(item);
+            if (it != tb.ids.end()) {
+                return it->second;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lck(tb.mtx);
+        auto it = tb.ids.find(item);
+        if (it != tb.ids.end()) {
+            return it->second;
+        }
+        uint32_t id = static_cast<uint32_t>(tb.items.size());
+        tb.items.push_back(item);
+        tb.ids.insert(std::make_pair(item, id));
+        return id;
+    }
+
+    static const std::string& name(uint32_t id) { return get(id).first; }
+    static const std::string& version(uint32_t id) { return get(id).second; }
+
+private:
+    struct Table {
+        Table() {
+            items.push_back(std::make_pair(std::string(), std::string()));
+            ids.insert(std::make_pair(items.front(), 0u));
+        }
+
+        std::shared_mutex mtx;
+        std::deque<std::pair<std::string, std::string>> items;
+        std::map<std::pair<std::string, std::string>, uint32_t> ids;
+    };
+
+    static Table& table(void) {
+        static Table tb;
+        return tb;
+    }
+
+    static const std::pair<std::string, std::string>& get(uint32_t id) {
+        Table& tb = table();
+        std::shared_lock<std::shared_mutex> lck(tb.mtx);
+        return id < tb.items.size() ? tb.items[id] : tb.items.front();
+    }
+};
+
+// Compact plugin reference used in message and stream headers: the plugin's
+// key plus its interned identity, so copying one never touches a string.
+template <typename T>
+struct PluginHandle {
+    PluginHandle() : key(), id(0) {}
+    PluginHandle(const T& key, uint32_t id) : key(key), id(id) {}
+    explicit PluginHandle(const PluginKey<T>& key)
+        : key(key.key), id(PluginIdentity::intern(key.name, key.version)) {
+    }
+
+    const std::string& name(void) const { return PluginIdentity::name(id); }
+    const std::string& version(void) const { return PluginIdentity::version(id); }
+
+    bool operator==(const PluginHandle<T>& other) const { return key == other.key; }
+
+    T key;
+    uint32_t id;
+};
+
 struct PluginDataT {
     int type;
     int len;
     void* data;
 };
 
+struct PluginUsage {
+    uint64_t calls;
+    uint64_t cpu_us;
+    uint64_t overruns;
+    bool quarantined;
+};
+
+struct MessageCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t entries;
+};
+
 template <typename T>
 struct PluginMessage {
-    PluginKey<T> from;
-    PluginKey<T> to;
+    PluginHandle<T> from;
+    PluginHandle<T> to;
     PluginDataT data;
 };
 
+typedef enum {
+    E_STREAM_READABLE = 0x01,
+    E_STREAM_WRITABLE = 0x02,
+    E_STREAM_CLOSED = 0x04,
+} stream_event_type;
+
+typedef enum {
+    E_FD_READ = 0x01,
+    E_FD_WRITE = 0x02,
+    E_FD_ERROR = 0x04,
+    E_FD_HANGUP = 0x08,
+} fd_event_type;
+
+typedef enum {
+    E_FD_LEVEL = 0x00,
+    E_FD_EDGE = 0x01,
+    E_FD_BATCH = 0x02,
+} fd_register_flag;
+
+struct PluginFdEvent {
+    int fd;
+    uint32_t events;
+};
+
 template <typename T>
 class IPluginStream {
 public:
+    IPluginStream(const PluginHandle<T>& from, const PluginHandle<T>& to)
+        : from_(from), to_(to), events_(0), window_(-1) {
+    }
+
+    // Streams are created rarely enough that interning here is fine.
     IPluginStream(const PluginKey<T>& from, const PluginKey<T>& to)
-        : from_(from), to_(to) {
+        : IPluginStream(PluginHandle<T>(from), PluginHandle<T>(to)) {
     }
     virtual ~IPluginStream() {}
 
@@ -58,9 +180,97 @@ public:
     virtual int send(const PluginDataT& data, const time_t wait = -1) = 0;
     virtual int recv(PluginDataT& data, const time_t wait = -1) = 0;
 
+    // Called by the stream implementation when data arrives, space frees up
+    // or the stream closes. For handlers that opted into stream_event() the
+    // kernel schedules a callback; otherwise the events are just recorded.
+    void notify(uint32_t events) {
+        events_.fetch_or(events);
+        wake();
+    }
+
+    // Allows n more readable callbacks before E_STREAM_READABLE is held back;
+    // a negative n removes the limit (the default).
+    void window_request(int n) {
+        if (n < 0) {
+            window_ = -1;
+        }
+        else {
+            int cur = window_.load();
+            while (!window_.compare_exchange_weak(cur, cur < 0 ? n : cur + n)) {
+            }
+        }
+        wake();
+    }
+
+    int window(void) const { return window_.load(); }
+
+private:
+    template <typename U>
+    friend class MicroKernelStreamSource;
+
+    void set_waker(const std::function<void(void)>& waker) {
+        std::lock_guard<std::mutex> lck(waker_mtx_);
+        waker_ = waker;
+    }
+
+    void wake(void) {
+        std::function<void(void)> waker;
+        {
+            std::lock_guard<std::mutex> lck(waker_mtx_);
+            waker = waker_;
+        }
+        if (waker) {
+            waker();
+        }
+    }
+
+    bool has_events(void) const {
+        uint32_t ev = events_.load();
+        if (window_.load() == 0) {
+            ev &= ~static_cast<uint32_t>(E_STREAM_READABLE);
+        }
+        return ev != 0;
+    }
+
+    uint32_t take_events(void) {
+        uint32_t mask = ~0u;
+        int win = window_.load();
+        while (win > 0 && (events_.load() & E_STREAM_READABLE)) {
+            if (window_.compare_exchange_weak(win, win - 1)) {
+                break;
+            }
+        }
+        if (win == 0) {
+            mask = ~static_cast<uint32_t>(E_STREAM_READABLE);
+        }
+        return events_.fetch_and(~mask) & mask;
+    }
+
+public:
+    PluginHandle<T> from_;
+    PluginHandle<T> to_;
+
+private:
+    std::atomic<uint32_t> events_;
+    std::atomic<int> window_;
+    std::mutex waker_mtx_;
+    std::function<void(void)> waker_;
+};
+
+// Dataflow graph of plugin stages. Stages are added and connected before
+// start(); push() feeds items into a stage and blocks (up to wait ms, -1 for
+// no limit) while that stage's queue is full. Payloads are not copied.
+template <typename T>
+class IPluginPipeline {
 public:
-    PluginKey<T> from_;
-    PluginKey<T> to_;
+    virtual ~IPluginPipeline() {}
+
+    virtual int add_stage(const T& key, size_t queue_limit = 1024, size_t batch_size = 32,
+        uint32_t parallel = 0) = 0;
+    virtual bool connect(int from_stage, int to_stage) = 0;
+    virtual bool start(void) = 0;
+    virtual bool push(int stage, const PluginDataT& item, const time_t wait = -1) = 0;
+    virtual void stop(void) = 0;
 };
 
 typedef enum {
@@ -77,11 +287,26 @@ public:
     virtual std::string micro_kernel_version(void) = 0;
     virtual uint32_t plugin_cnt(void) = 0;
     virtual bool plugin_key(const T& key, PluginKey<T>& item_key) = 0;
-    virtual bool message_dispatch(const PluginKey<T>& from, const T& to_key,
+    virtual bool plugin_usage(const T& key, PluginUsage& usage) = 0;
+    virtual bool message_dispatch(const PluginHandle<T>& from, const T& to_key,
         const PluginDataT& request,
         PluginDataT& response) = 0;
     virtual bool stream_dispatch(std::shared_ptr<IPluginStream<T>> stream) = 0;
 
+    virtual void message_cache_invalidate(const T& key) = 0;
+    virtual void message_cache_invalidate(const T& key, int type) = 0;
+    virtual MessageCacheStats message_cache_stats(void) = 0;
+
+    // Watches fd for fd_event_type interest on the kernel's epoll loop and
+    // calls IPlugin::fd_event() of plugin key on the thread pool when it is
+    // ready. E_FD_EDGE selects edge-triggered delivery; E_FD_BATCH merges the
+    // events of all the plugin's batched fds into one fd_event() call.
+    virtual bool fd_register(const T& key, int fd, uint32_t events, uint32_t flags = E_FD_LEVEL) = 0;
+    virtual bool fd_modify(const T& key, int fd, uint32_t events) = 0;
+    virtual bool fd_unregister(const T& key, int fd) = 0;
+
+    virtual std::shared_ptr<IPluginPipeline<T>> pipeline_create(void) = 0;
+
     virtual void log(const std::string& message) = 0;
 };
 
@@ -90,6 +315,7 @@ class IPlugin {
 public:
     IPlugin(const PluginKey<T>& key)
         : plugin_key_(key),
+        plugin_handle_(key),
         plugin_st_(E_PLUGIN_STOP),
         mic_kernel_srv_(nullptr) {
     }
@@ -97,6 +323,7 @@ public:
     virtual ~IPlugin() {}
 
     const PluginKey<T>& plugin_key(void) const { return plugin_key_; }
+    const PluginHandle<T>& plugin_handle(void) const { return plugin_handle_; }
 
     plugin_run_status plugin_status(void) { return plugin_st_; }
 
@@ -178,6 +405,32 @@ public:
         PluginMessage<T>& response) = 0;
     virtual bool stream(std::shared_ptr<IPluginStream<T>> stream) = 0;
 
+    // Responses to message types with a ttl (ms) > 0 are cached by the kernel
+    // and served without calling message() until they expire or are invalidated.
+    virtual time_t message_cache_ttl(int /*type*/) { return 0; }
+
+    // Plugins returning true from stream_reactive() are not handed streams
+    // through stream(); the kernel calls stream_event() on the thread pool
+    // each time the stream notifies readiness, so idle streams hold no worker.
+    // Returning false from stream_event() detaches the stream.
+    virtual bool stream_reactive(void) { return false; }
+    virtual bool stream_event(std::shared_ptr<IPluginStream<T>> /*stream*/, uint32_t /*events*/) {
+        return false;
+    }
+
+    // Readiness of fds registered through fd_register(). Calls for the same
+    // fd never overlap; a level-triggered fd is re-armed after this returns.
+    virtual void fd_event(const std::vector<PluginFdEvent>& /*events*/) {}
+
+    // Pipeline stage body: handles one micro-batch and appends the items to
+    // forward downstream to out. Stateless plugins may run several batches
+    // of the same stage concurrently.
+    virtual bool pipeline_batch(const std::vector<PluginDataT>& /*in*/,
+        std::vector<PluginDataT>& /*out*/) {
+        return false;
+    }
+    virtual bool plugin_stateless(void) { return false; }
+
 private:
     friend class MicroKernel<T>;
     void set_plugin_status(plugin_run_status st) { plugin_st_ = st; }
@@ -187,7 +440,9 @@ private:
 
 private:
     PluginKey<T> plugin_key_;
-    plugin_run_status plugin_st_;
+    PluginHandle<T> plugin_handle_;
+    std::atomic<plugin_run_status> plugin_st_;    // read by pipeline workers
     IMicroKernelServices<T>* mic_kernel_srv_;
+    std::shared_ptr<MicroPluginAccount> plugin_account_;
 };
 
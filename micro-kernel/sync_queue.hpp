@@ -1,5 +1,6 @@
 #pragma once
 #include <stddef.h>
+#include <vector>
 
 
 template <typename T>
@@ -7,6 +8,8 @@ class ISyncQueue {
 public:
     virtual ~ISyncQueue() {}
     virtual bool push(T&& obj) = 0;
+    virtual bool try_push(T&& obj) = 0;
+    virtual bool push_batch(std::vector<T>& objs) = 0;
     virtual bool pop(T& t) = 0;
     virtual size_t count(void) = 0;
     virtual bool empty(void) = 0;
@@ -1,5 +1,6 @@
 #pragma once
 #include <functional>
+#include <vector>
 
 
 
@@ -11,6 +12,19 @@ public:
     virtual void run() = 0;
     virtual void stop() = 0;
     virtual void add_task(const thread_task_t& task) = 0;
+
+    // Non-blocking submit for callers that run on a pool worker themselves;
+    // false means the task was not queued and the caller should run it.
+    virtual bool try_add_task(const thread_task_t& /*task*/) { return false; }
+
+    // Submits a whole batch. The default hands each task to add_task(), which
+    // copies it; pools that can enqueue under a single lock override this
+    // and may move the tasks out of the vector.
+    virtual void add_tasks(std::vector<thread_task_t>& tasks) {
+        for (auto& task : tasks) {
+            add_task(task);
+        }
+    }
 };
 
 